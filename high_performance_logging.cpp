@@ -0,0 +1,2864 @@
+/*
+ *  High-Performance Logging Examples
+ */
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <concepts>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#define HAVE_IO_URING 1
+#endif
+
+/*
+ * Thread-name interning: log calls pass a small handle instead of a string
+ */
+
+// Small integer handle for an interned thread name
+struct ThreadHandle {
+	std::uint32_t index;
+};
+
+// Process-wide registry that interns each thread name once. Log calls
+// only pass handles around; sinks resolve them back to text.
+class ThreadRegistry {
+public:
+	// Maximum number of distinct thread names
+	static constexpr std::uint32_t max_names = 4096;
+
+	// Intern a name, equal names always map to the same handle
+	static ThreadHandle intern(std::string_view name) {
+		Storage& storage = instance();
+		std::lock_guard<std::mutex> lock(storage.mutex);
+		const auto found = storage.handles.find(name);
+		if (found != storage.handles.end()) {
+			return ThreadHandle{found->second};
+		}
+		const auto index = static_cast<std::uint32_t>(storage.names.size());
+		if (index == max_names) {
+			throw std::length_error("ThreadRegistry is full");
+		}
+		// The deque never moves its strings, so views and pointers stay valid
+		const std::string& stored = storage.names.emplace_back(name);
+		storage.handles.emplace(stored, index);
+		storage.lookup[index].store(&stored, std::memory_order_release);
+		return ThreadHandle{index};
+	}
+
+	// Resolve a handle back to its name without taking a lock
+	static std::string_view name(ThreadHandle handle) {
+		return *instance().lookup[handle.index].load(std::memory_order_acquire);
+	}
+
+	// Name the calling thread, called once when the thread starts
+	static void set_current(std::string_view name) {
+		current_handle() = intern(name);
+	}
+
+	// Handle of the calling thread, a plain thread-local read
+	static ThreadHandle current() {
+		return current_handle();
+	}
+
+private:
+	struct Storage {
+		// Mutex taken only while interning
+		std::mutex mutex;
+		// Owned copies of every interned name
+		std::deque<std::string> names;
+		// Name to handle index, keyed by views into names
+		std::unordered_map<std::string_view, std::uint32_t> handles;
+		// Handle index to name, readable without the mutex
+		std::array<std::atomic<const std::string*>, max_names> lookup{};
+	};
+
+	static Storage& instance() {
+		static Storage storage;
+		return storage;
+	}
+
+	static ThreadHandle& current_handle() {
+		// Threads that never called set_current() share one default name
+		thread_local ThreadHandle handle = intern("Unnamed Thread");
+		return handle;
+	}
+};
+
+// Mutex protecting the console
+std::mutex console_mutex;
+
+// Function to print shared data, takes a handle so no string is built or copied per call
+void print_shared_data(ThreadHandle thread_id, int value) {
+	std::lock_guard<std::mutex> lock(console_mutex);
+	// Only the sink resolves the handle back to text
+	std::cout << "From " << ThreadRegistry::name(thread_id) << ": " << value << '\n';
+}
+
+// Functor class for thread execution with an interned thread name
+class InternedTask {
+public:
+	// Operator() names its thread once, then logs with the thread-local handle
+	void operator()() {
+		ThreadRegistry::set_current("Thread 1");
+		for (int i = -1; i >= -100; --i) {
+			print_shared_data(ThreadRegistry::current(), i);
+		}
+	}
+};
+
+int main() {
+	// Create a thread and pass the functor object to it
+	std::thread thread1{InternedTask()};
+
+	// Name the main thread once before its loop
+	ThreadRegistry::set_current("Main Thread");
+	for (int i = 0; i < 100; ++i) {
+		print_shared_data(ThreadRegistry::current(), i);
+	}
+
+	// Wait for the thread to finish
+	thread1.join();
+	return 0;
+}
+
+/*
+ * Asynchronous logging with per-thread lock-free ring buffers
+ */
+
+// Fixed-size record copied by the calling thread into its own ring
+struct LogRecord {
+	// Interned thread id, resolved by the writer thread
+	ThreadHandle thread_id;
+	// Value to log
+	int value;
+};
+
+// Single-producer/single-consumer ring: the owning thread pushes,
+// the background writer thread drains
+class LogRing {
+public:
+	// Number of records in the ring, must be a power of two
+	static constexpr std::size_t capacity = 4096;
+
+	// Called only by the owning thread, returns false when the ring is full
+	bool try_push(const LogRecord& record) {
+		const std::size_t head = write_index.load(std::memory_order_relaxed);
+		// The writer has not yet drained the oldest record
+		if (head - read_index.load(std::memory_order_acquire) == capacity) {
+			return false;
+		}
+		records[head & (capacity - 1)] = record;
+		// Publish the record to the writer thread
+		write_index.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Called only by the writer thread, passes every pending record to func
+	template <typename Func>
+	std::size_t drain(Func func) {
+		const std::size_t tail = read_index.load(std::memory_order_relaxed);
+		const std::size_t head = write_index.load(std::memory_order_acquire);
+		for (std::size_t i = tail; i != head; ++i) {
+			func(records[i & (capacity - 1)]);
+		}
+		// Hand the drained slots back to the owning thread
+		read_index.store(head, std::memory_order_release);
+		return head - tail;
+	}
+
+private:
+	// Indices live on separate cache lines so producer and writer do not false-share
+	alignas(64) std::atomic<std::size_t> write_index{0};
+	alignas(64) std::atomic<std::size_t> read_index{0};
+	alignas(64) LogRecord records[capacity];
+};
+
+// Per-thread lookup of a logger's slot (ring, buffer, shard) for the calling
+// thread. Every instance gets an id that is never reused, and each thread
+// caches (id, slot) pairs for the instances it has used. A cache miss also
+// drops the pairs of destroyed instances, so the cache only holds loggers
+// that are still alive.
+template <typename Slot>
+class ThreadSlots {
+	using Entry = std::pair<std::uint64_t, Slot*>;
+
+	// Ids of the live instances, touched only on construction, destruction and cache misses
+	struct Registry {
+		std::mutex mutex;
+		std::uint64_t next_id = 1;
+		std::unordered_set<std::uint64_t> live;
+	};
+
+	static Registry& registry() {
+		static Registry instance;
+		return instance;
+	}
+
+	static std::vector<Entry>& cache() {
+		thread_local std::vector<Entry> entries;
+		return entries;
+	}
+
+	// Drop the entries of instances that have been destroyed
+	static void prune(std::vector<Entry>& entries) {
+		Registry& shared = registry();
+		std::lock_guard<std::mutex> lock(shared.mutex);
+		std::erase_if(entries, [&shared](const Entry& entry) { return !shared.live.contains(entry.first); });
+	}
+
+	std::uint64_t id;
+
+public:
+	// Constructor that registers a fresh id
+	ThreadSlots() {
+		Registry& shared = registry();
+		std::lock_guard<std::mutex> lock(shared.mutex);
+		id = shared.next_id++;
+		shared.live.insert(id);
+	}
+
+	// Destructor that retires the id, threads drop it on their next miss
+	~ThreadSlots() {
+		Registry& shared = registry();
+		std::lock_guard<std::mutex> lock(shared.mutex);
+		shared.live.erase(id);
+	}
+
+	// Prevent copying, the id identifies exactly one owner
+	ThreadSlots(const ThreadSlots&) = delete;
+	ThreadSlots& operator=(const ThreadSlots&) = delete;
+
+	// Return the calling thread's slot, calling create() on its first use
+	template <typename Create>
+	Slot& local(Create create) {
+		std::vector<Entry>& entries = cache();
+		for (const Entry& entry : entries) {
+			if (entry.first == id) {
+				return *entry.second;
+			}
+		}
+		prune(entries);
+		Slot* slot = create();
+		entries.emplace_back(id, slot);
+		return *slot;
+	}
+};
+
+class AsyncLogger {
+	// Log file stream, only touched by the writer thread
+	std::ofstream log_file;
+	// Mutex taken only when a thread logs for the first time
+	std::mutex rings_mutex;
+	// One ring per thread that has logged through this logger
+	std::vector<std::unique_ptr<LogRing>> rings;
+	// The calling thread's ring, looked up without a lock
+	ThreadSlots<LogRing> ring_slots;
+	// Cleared by the destructor to stop the writer thread
+	std::atomic<bool> running{true};
+	// Background thread that drains the rings into the log file
+	std::thread writer;
+
+	// Return the calling thread's ring, registering one on first use
+	LogRing& local_ring() {
+		return ring_slots.local([this]() {
+			// Slow path: first record from this thread
+			std::lock_guard<std::mutex> lock(rings_mutex);
+			rings.push_back(std::make_unique<LogRing>());
+			return rings.back().get();
+		});
+	}
+
+	// Append one record in today's text format to the batch buffer
+	static void format_record(std::string& batch, const LogRecord& record) {
+		char digits[16];
+		const auto result = std::to_chars(digits, digits + sizeof(digits), record.value);
+		batch.append("From ");
+		batch.append(ThreadRegistry::name(record.thread_id));
+		batch.append(": ");
+		batch.append(digits, result.ptr);
+		batch.push_back('\n');
+	}
+
+	// Writer thread: drain every ring and write the result as one large batch
+	void write_loop() {
+		std::string batch;
+		batch.reserve(1 << 20);
+		std::vector<LogRing*> snapshot;
+		while (true) {
+			// Read the flag before draining so the last pass sees every record
+			const bool stopping = !running.load(std::memory_order_acquire);
+			{
+				std::lock_guard<std::mutex> lock(rings_mutex);
+				snapshot.clear();
+				for (const auto& ring : rings) {
+					snapshot.push_back(ring.get());
+				}
+			}
+			std::size_t drained = 0;
+			for (LogRing* ring : snapshot) {
+				drained += ring->drain([&batch](const LogRecord& record) {
+					format_record(batch, record);
+				});
+			}
+			if (!batch.empty()) {
+				log_file.write(batch.data(), static_cast<std::streamsize>(batch.size()));
+				batch.clear();
+			}
+			if (stopping) {
+				break;
+			}
+			// Nothing to do, back off instead of spinning on empty rings
+			if (drained == 0) {
+				std::this_thread::sleep_for(std::chrono::microseconds(200));
+			}
+		}
+		log_file.flush();
+	}
+
+public:
+	// Constructor that opens the log file and starts the writer thread
+	AsyncLogger() {
+		log_file.open("async_log.txt");
+		writer = std::thread(&AsyncLogger::write_loop, this);
+	}
+
+	// Destructor that drains the remaining records and stops the writer.
+	// Every logging thread must have finished before the logger is destroyed.
+	~AsyncLogger() {
+		running.store(false, std::memory_order_release);
+		writer.join();
+	}
+
+	// Function to log data, only touches thread-local memory on the hot path
+	void log(ThreadHandle thread_id, int value) {
+		const LogRecord record{thread_id, value};
+		LogRing& ring = local_ring();
+		// The ring is full: wait for the writer instead of dropping the record
+		while (!ring.try_push(record)) {
+			std::this_thread::yield();
+		}
+	}
+};
+
+// Functor class for thread execution with AsyncLogger
+class AsyncLoggerTask {
+	// Reference to the AsyncLogger object
+	AsyncLogger& logger;
+
+public:
+	// Constructor that takes a reference to an AsyncLogger object
+	AsyncLoggerTask(AsyncLogger& log) : logger(log) {}
+
+	// Operator() is called by the thread and logs through its own ring
+	void operator()() {
+		ThreadRegistry::set_current("Thread 1");
+		for (int i = -1; i >= -100; --i) {
+			logger.log(ThreadRegistry::current(), i);
+		}
+	}
+};
+
+int main() {
+	// Create an instance of the AsyncLogger class
+	AsyncLogger logger;
+	// Create a thread and pass the functor object to it
+	std::thread thread1{AsyncLoggerTask(logger)};
+
+	// Main thread loop
+	ThreadRegistry::set_current("Main Thread");
+	for (int i = 0; i < 100; ++i) {
+		logger.log(ThreadRegistry::current(), i);
+	}
+
+	// Wait for the thread to finish, the logger flushes on destruction
+	thread1.join();
+	return 0;
+}
+
+/*
+ * Benchmark: per-call latency percentiles and aggregate throughput
+ */
+
+// Return the sample at the given fraction (0.0 - 1.0) of the sorted order
+std::uint64_t percentile(std::vector<std::uint64_t>& samples, double fraction) {
+	const auto index = static_cast<std::size_t>(fraction * static_cast<double>(samples.size() - 1));
+	std::nth_element(samples.begin(), samples.begin() + static_cast<std::ptrdiff_t>(index), samples.end());
+	return samples[index];
+}
+
+// Log records_per_thread records from each of thread_count threads and
+// print per-call latency percentiles plus records/sec including the final drain
+void benchmark_async_logger(int thread_count, int records_per_thread) {
+	using clock = std::chrono::steady_clock;
+	// One latency vector per thread so that recording does not synchronize
+	std::vector<std::vector<std::uint64_t>> latencies(static_cast<std::size_t>(thread_count));
+	const auto start = clock::now();
+	{
+		AsyncLogger logger;
+		std::vector<std::thread> threads;
+		for (int t = 0; t < thread_count; ++t) {
+			threads.emplace_back([&logger, &latencies, t, records_per_thread]() {
+				auto& samples = latencies[static_cast<std::size_t>(t)];
+				samples.reserve(static_cast<std::size_t>(records_per_thread));
+				ThreadRegistry::set_current("Thread " + std::to_string(t));
+				const ThreadHandle thread_id = ThreadRegistry::current();
+				for (int i = 0; i < records_per_thread; ++i) {
+					const auto before = clock::now();
+					logger.log(thread_id, i);
+					const auto after = clock::now();
+					samples.push_back(static_cast<std::uint64_t>(
+						std::chrono::duration_cast<std::chrono::nanoseconds>(after - before).count()));
+				}
+			});
+		}
+		for (auto& thread : threads) {
+			thread.join();
+		}
+	}
+	const std::chrono::duration<double> elapsed = clock::now() - start;
+
+	// Merge all samples and report
+	std::vector<std::uint64_t> all;
+	for (const auto& samples : latencies) {
+		all.insert(all.end(), samples.begin(), samples.end());
+	}
+	const double records_per_sec = static_cast<double>(all.size()) / elapsed.count();
+	std::cout << thread_count << " threads: "
+		<< "p50 " << percentile(all, 0.50) << " ns, "
+		<< "p99 " << percentile(all, 0.99) << " ns, "
+		<< "p99.9 " << percentile(all, 0.999) << " ns, "
+		<< "max " << percentile(all, 1.0) << " ns, "
+		<< static_cast<std::uint64_t>(records_per_sec) << " records/sec" << std::endl;
+}
+
+int main() {
+	// Sweep from 1 to 64 logging threads
+	for (int threads = 1; threads <= 64; threads *= 2) {
+		benchmark_async_logger(threads, 20000);
+	}
+	return 0;
+}
+
+/*
+ * Binary log records with deferred formatting
+ */
+
+// Every binary log starts with this 8-byte magic
+constexpr char binary_log_magic[8] = {'C', 'L', 'O', 'G', 'B', 'I', 'N', '1'};
+// Set in BinaryLogRecord::thread when the record defines a thread name:
+// value then holds the name length and the name bytes follow the record
+constexpr std::uint32_t thread_name_definition = 0x80000000u;
+
+// Compact 16-byte record written instead of "From <id>: <value>"
+struct BinaryLogRecord {
+	// Nanoseconds since the system clock epoch
+	std::uint64_t timestamp_ns;
+	// Interned thread id, or a name definition
+	std::uint32_t thread;
+	// Value to log
+	std::int32_t value;
+};
+
+class BinaryLogger {
+	// Mutex to protect the log file and the defined thread table
+	std::mutex file_mutex;
+	// Large stream buffer so records reach the disk in big writes
+	std::vector<char> stream_buffer;
+	// Log file stream, opened in binary mode
+	std::ofstream log_file;
+	// Thread handles whose name has already been written to this file
+	std::vector<bool> defined_threads;
+
+	// Write a record that maps a handle to its thread name, called with the lock held
+	void define_thread(ThreadHandle thread_id) {
+		if (defined_threads.size() <= thread_id.index) {
+			defined_threads.resize(thread_id.index + 1);
+		}
+		defined_threads[thread_id.index] = true;
+		const std::string_view name = ThreadRegistry::name(thread_id);
+		const BinaryLogRecord definition{0, thread_id.index | thread_name_definition,
+			static_cast<std::int32_t>(name.size())};
+		log_file.write(reinterpret_cast<const char*>(&definition), sizeof(definition));
+		log_file.write(name.data(), static_cast<std::streamsize>(name.size()));
+	}
+
+public:
+	// Constructor that opens the log file and writes the header
+	BinaryLogger(const std::string& path = "binary_log.bin") : stream_buffer(1 << 16) {
+		log_file.rdbuf()->pubsetbuf(stream_buffer.data(), static_cast<std::streamsize>(stream_buffer.size()));
+		log_file.open(path, std::ios::binary);
+		log_file.write(binary_log_magic, sizeof(binary_log_magic));
+	}
+
+	// Function to log data, copies a fixed-size tuple without any formatting
+	void log_data(ThreadHandle thread_id, int value) {
+		// Take the timestamp outside the critical section
+		const auto timestamp = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::system_clock::now().time_since_epoch()).count());
+		// Acquire the lock only for the duration of the copy
+		std::lock_guard<std::mutex> lock(file_mutex);
+		if (thread_id.index >= defined_threads.size() || !defined_threads[thread_id.index]) {
+			define_thread(thread_id);
+		}
+		const BinaryLogRecord record{timestamp, thread_id.index, value};
+		log_file.write(reinterpret_cast<const char*>(&record), sizeof(record));
+	}
+};
+
+int main() {
+	BinaryLogger binary_logger;
+
+	// Create a thread that logs through the binary logger
+	std::thread thread1([&binary_logger]() {
+		ThreadRegistry::set_current("Thread 1");
+		for (int i = -1; i >= -100; --i) {
+			binary_logger.log_data(ThreadRegistry::current(), i);
+		}
+	});
+
+	// Main thread loop
+	ThreadRegistry::set_current("Main Thread");
+	for (int i = 0; i < 100; ++i) {
+		binary_logger.log_data(ThreadRegistry::current(), i);
+	}
+
+	// Wait for the thread to finish
+	thread1.join();
+	return 0;
+}
+
+/*
+ * Offline decoder: turns a binary log back into today's text format
+ */
+
+// Longest thread name the decoder accepts, anything larger is a corrupt length
+constexpr std::size_t max_thread_name_length = 1 << 16;
+
+// Bytes between the read position and the end of input, or max_thread_name_length
+// when the stream cannot seek (the read itself then catches truncation)
+std::size_t remaining_input(std::istream& input) {
+	const std::istream::pos_type position = input.tellg();
+	if (position == std::istream::pos_type(-1) || !input.seekg(0, std::ios::end)) {
+		input.clear();
+		return max_thread_name_length;
+	}
+	const std::istream::pos_type end = input.tellg();
+	input.seekg(position);
+	return static_cast<std::size_t>(end - position);
+}
+
+// Decode every record from input into "From <id>: <value>" lines on output,
+// returns false if the input is not a complete binary log
+bool decode_binary_log(std::istream& input, std::ostream& output) {
+	char magic[sizeof(binary_log_magic)];
+	if (!input.read(magic, sizeof(magic)) || std::memcmp(magic, binary_log_magic, sizeof(magic)) != 0) {
+		return false;
+	}
+	// Thread names indexed by interned id, and which ids have been defined
+	// (an interned name may legitimately be empty)
+	std::vector<std::string> thread_names;
+	std::vector<bool> defined;
+	BinaryLogRecord record;
+	while (input.read(reinterpret_cast<char*>(&record), sizeof(record))) {
+		if (record.thread & thread_name_definition) {
+			// Name definition: read the name bytes that follow the record
+			// Reject ids and lengths no writer could produce before allocating for them
+			const std::uint32_t id = record.thread & ~thread_name_definition;
+			if (id >= ThreadRegistry::max_names || record.value < 0) {
+				return false;
+			}
+			const auto length = static_cast<std::size_t>(record.value);
+			if (length > max_thread_name_length || length > remaining_input(input)) {
+				return false;
+			}
+			if (thread_names.size() <= id) {
+				thread_names.resize(id + 1);
+				defined.resize(id + 1);
+			}
+			defined[id] = true;
+			thread_names[id].resize(length);
+			if (!input.read(thread_names[id].data(), record.value)) {
+				return false;
+			}
+			continue;
+		}
+		// A record may only use an id whose name was defined earlier in the log
+		if (record.thread >= thread_names.size() || !defined[record.thread]) {
+			return false;
+		}
+		output << "From " << thread_names[record.thread] << ": " << record.value << '\n';
+	}
+	// A trailing partial record means the log was truncated
+	return input.gcount() == 0;
+}
+
+int main(int argc, char* argv[]) {
+	if (argc < 2) {
+		std::cerr << "Usage: " << argv[0] << " <binary_log.bin> [output.txt]" << std::endl;
+		return 1;
+	}
+	std::ifstream input(argv[1], std::ios::binary);
+	std::ofstream output_file;
+	if (argc > 2) {
+		output_file.open(argv[2]);
+	}
+	std::ostream& output = argc > 2 ? output_file : std::cout;
+	if (!decode_binary_log(input, output)) {
+		std::cerr << "Malformed or truncated binary log: " << argv[1] << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+/*
+ * Benchmark: binary records against the text Logger
+ */
+
+// Text logger from thread_synchronization_example.cpp, used as the baseline
+class TextLogger {
+	// Mutex to protect the log file
+	std::mutex file_mutex;
+	// Log file stream
+	std::ofstream log_file;
+
+public:
+	// Constructor that opens the log file
+	TextLogger() {
+		log_file.open("text_log.txt");
+	}
+
+	// Function to print to log file with thread safety
+	void log(const std::string& thread_id, int value) {
+		std::lock_guard<std::mutex> lock(file_mutex);
+		log_file << "From " << thread_id << ": " << value << std::endl;
+	}
+};
+
+// Run records_per_thread calls of log_call on each of thread_count threads, returns seconds
+template <typename LogCall>
+double time_log_calls(int thread_count, int records_per_thread, LogCall log_call) {
+	const auto start = std::chrono::steady_clock::now();
+	std::vector<std::thread> threads;
+	for (int t = 0; t < thread_count; ++t) {
+		threads.emplace_back([&log_call, t, records_per_thread]() {
+			// The text baseline takes the name, interned loggers read the thread-local handle
+			const std::string thread_id = "Thread " + std::to_string(t);
+			ThreadRegistry::set_current(thread_id);
+			for (int i = 0; i < records_per_thread; ++i) {
+				log_call(thread_id, i);
+			}
+		});
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	return elapsed.count();
+}
+
+int main() {
+	const int thread_count = 4;
+	const int records_per_thread = 100000;
+	const double records = static_cast<double>(thread_count) * records_per_thread;
+
+	double text_seconds = 0;
+	{
+		TextLogger text_logger;
+		text_seconds = time_log_calls(thread_count, records_per_thread,
+			[&text_logger](const std::string& id, int value) { text_logger.log(id, value); });
+	}
+	double binary_seconds = 0;
+	{
+		BinaryLogger binary_logger;
+		binary_seconds = time_log_calls(thread_count, records_per_thread,
+			[&binary_logger](const std::string&, int value) {
+				binary_logger.log_data(ThreadRegistry::current(), value);
+			});
+	}
+
+	// Compare CPU time and bytes per record
+	std::ifstream text_file("text_log.txt", std::ios::binary | std::ios::ate);
+	std::ifstream binary_file("binary_log.bin", std::ios::binary | std::ios::ate);
+	std::cout << "Text:   " << text_seconds * 1e9 / records << " ns/record, "
+		<< static_cast<double>(text_file.tellg()) / records << " bytes/record" << std::endl;
+	std::cout << "Binary: " << binary_seconds * 1e9 / records << " ns/record, "
+		<< static_cast<double>(binary_file.tellg()) / records << " bytes/record" << std::endl;
+	return 0;
+}
+
+/*
+ * Memory-mapped append-only sink: no mutex and no syscall per line
+ */
+
+// Owns a file descriptor and closes it on destruction
+class FileDescriptor {
+	int fd = -1;
+
+public:
+	explicit FileDescriptor(int descriptor = -1) : fd(descriptor) {}
+	FileDescriptor(const FileDescriptor&) = delete;
+	FileDescriptor& operator=(const FileDescriptor&) = delete;
+	~FileDescriptor() {
+		reset();
+	}
+
+	int get() const {
+		return fd;
+	}
+
+	void reset() {
+		if (fd >= 0) {
+			::close(fd);
+			fd = -1;
+		}
+	}
+};
+
+// Owns a shared mapping and unmaps it on destruction
+class MemoryMapping {
+	char* address = nullptr;
+	std::size_t size = 0;
+
+public:
+	MemoryMapping() = default;
+	MemoryMapping(const MemoryMapping&) = delete;
+	MemoryMapping& operator=(const MemoryMapping&) = delete;
+	~MemoryMapping() {
+		reset();
+	}
+
+	// Map length bytes of fd read-write, throws on failure
+	void map(int fd, std::size_t length, const std::string& what) {
+		void* mapped = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (mapped == MAP_FAILED) {
+			throw std::system_error(errno, std::generic_category(), "mmap " + what);
+		}
+		reset();
+		address = static_cast<char*>(mapped);
+		size = length;
+	}
+
+	char* data() const {
+		return address;
+	}
+
+	void reset() {
+		if (address) {
+			::munmap(address, size);
+			address = nullptr;
+		}
+	}
+};
+
+class MappedLogSink {
+	// Log file, closed by close() or on destruction (also when the constructor throws)
+	FileDescriptor fd;
+	// Mapping that covers the whole capacity
+	MemoryMapping mapping;
+	// Size of the mapped address range, the file never grows past it
+	std::size_t capacity;
+	// The file is extended in chunks of this many bytes
+	std::size_t chunk_size;
+	// Next free offset, writers reserve byte ranges with fetch_add
+	std::atomic<std::size_t> reserved{0};
+	// Current file size, every mapped byte below it is backed by the file
+	std::atomic<std::size_t> extended{0};
+	// Offset of the first reservation that did not fit into the capacity
+	std::atomic<std::size_t> overflow_offset;
+	// Records rejected because the capacity was exhausted
+	std::atomic<std::size_t> dropped{0};
+	// Mutex taken only to extend the file by another chunk
+	std::mutex extend_mutex;
+
+	// Grow the file so that every offset below end is backed
+	void extend_to(std::size_t end) {
+		std::lock_guard<std::mutex> lock(extend_mutex);
+		// Another writer may have extended the file while we waited
+		if (end <= extended.load(std::memory_order_relaxed)) {
+			return;
+		}
+		const std::size_t new_size = std::min(capacity, (end + chunk_size - 1) / chunk_size * chunk_size);
+		if (::ftruncate(fd.get(), static_cast<off_t>(new_size)) != 0) {
+			throw std::system_error(errno, std::generic_category(), "ftruncate");
+		}
+		extended.store(new_size, std::memory_order_release);
+	}
+
+public:
+	// Constructor that creates the file and maps capacity bytes of address space
+	MappedLogSink(const std::string& path, std::size_t chunk = std::size_t{4} << 20,
+		std::size_t max_size = std::size_t{1} << 30)
+		: fd(::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644)), capacity(max_size), chunk_size(chunk),
+		  overflow_offset(max_size) {
+		if (fd.get() < 0) {
+			throw std::system_error(errno, std::generic_category(), "open " + path);
+		}
+		// Mapping past the end of the file is allowed, those pages become
+		// usable once ftruncate extends the file over them
+		mapping.map(fd.get(), capacity, path);
+		extend_to(chunk_size);
+	}
+
+	// Prevent copying, the sink owns the mapping
+	MappedLogSink(const MappedLogSink&) = delete;
+	MappedLogSink& operator=(const MappedLogSink&) = delete;
+
+	// Destructor that truncates the file to the bytes actually written
+	~MappedLogSink() {
+		close();
+	}
+
+	// Append one complete record, safe to call from any number of threads.
+	// Returns false once the capacity is exhausted; the record is dropped and
+	// counted in dropped_records(). The mapping cannot grow in place without
+	// stalling every writer, so size max_size for the expected volume instead.
+	bool append(const char* data, std::size_t size) {
+		// Reserve a private byte range, no other writer can touch it
+		const std::size_t offset = reserved.fetch_add(size, std::memory_order_relaxed);
+		if (offset + size > capacity) {
+			// Remember where the valid data ends so close() can drop the partial tail
+			std::size_t current = overflow_offset.load(std::memory_order_relaxed);
+			while (offset < current && !overflow_offset.compare_exchange_weak(current, offset)) {
+			}
+			dropped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		// Rare slow path: the range crosses the end of the file
+		if (offset + size > extended.load(std::memory_order_acquire)) {
+			extend_to(offset + size);
+		}
+		std::memcpy(mapping.data() + offset, data, size);
+		return true;
+	}
+
+	// Number of records append() rejected because the capacity was exhausted
+	std::size_t dropped_records() const {
+		return dropped.load(std::memory_order_relaxed);
+	}
+
+	// Unmap and truncate the file to its final size.
+	// Every writer must have finished before close() is called.
+	void close() {
+		if (fd.get() < 0) {
+			return;
+		}
+		const std::size_t final_size = std::min(reserved.load(), overflow_offset.load());
+		mapping.reset();
+		if (::ftruncate(fd.get(), static_cast<off_t>(final_size)) != 0) {
+			std::cerr << "MappedLogSink: ftruncate failed" << std::endl;
+		}
+		if (dropped_records() > 0) {
+			std::cerr << "MappedLogSink: dropped " << dropped_records() << " records, capacity exhausted" << std::endl;
+		}
+		fd.reset();
+	}
+};
+
+// Format "<prefix><value>\n" into line and return its length,
+// prefix is truncated if it does not fit
+std::size_t format_line(char (&line)[128], std::string_view prefix, int value) {
+	const std::size_t length = std::min(prefix.size(), sizeof(line) - 16);
+	std::memcpy(line, prefix.data(), length);
+	char* end = std::to_chars(line + length, line + sizeof(line) - 1, value).ptr;
+	*end++ = '\n';
+	return static_cast<std::size_t>(end - line);
+}
+
+// FileWriter from concurrent_programming_examples.cpp, writing through the mapped sink
+class MappedFileWriter {
+	// Reference to the shared sink
+	MappedLogSink& sink;
+
+public:
+	// Constructor that takes a reference to a MappedLogSink
+	MappedFileWriter(MappedLogSink& s) : sink(s) {}
+
+	// Operator() is called by the thread, each line is one reservation
+	// so lines from different threads never interleave
+	void operator()() {
+		char line[128];
+		for (int i = 0; i > -100; --i) {
+			sink.append(line, format_line(line, "From thread: ", i));
+		}
+	}
+};
+
+int main() {
+	// Create the sink, which creates and maps the file
+	MappedLogSink sink("log.txt");
+
+	// Create a thread and pass the MappedFileWriter object as its argument
+	MappedFileWriter writer(sink);
+	std::thread t1(writer);
+
+	// The main thread writes to the same sink without a mutex
+	char line[128];
+	for (int i = 0; i < 100; ++i) {
+		sink.append(line, format_line(line, "From main: ", i));
+	}
+
+	// Wait for the thread to finish, then truncate the file to size
+	t1.join();
+	sink.close();
+
+	return 0;
+}
+
+// Format "From <id>: <value>\n" into line and return its length
+std::size_t format_record_line(char (&line)[128], ThreadHandle thread_id, int value) {
+	char prefix[96] = "From ";
+	const std::string_view name = ThreadRegistry::name(thread_id);
+	const std::size_t name_length = std::min(name.size(), sizeof(prefix) - 8);
+	std::memcpy(prefix + 5, name.data(), name_length);
+	std::memcpy(prefix + 5 + name_length, ": ", 2);
+	return format_line(line, std::string_view(prefix, 7 + name_length), value);
+}
+
+// Logger that writes "From <id>: <value>" lines through a mapped sink
+class MappedLogger {
+	// Mapped sink that replaces the mutex and the ofstream
+	MappedLogSink sink;
+
+public:
+	// Constructor that creates the mapped log file
+	MappedLogger() : sink("mapped_log.txt") {}
+
+	// Function to log data, formats on the stack and copies into the mapping.
+	// Returns false if the record was dropped because the log is full.
+	bool log(ThreadHandle thread_id, int value) {
+		char line[128];
+		return sink.append(line, format_record_line(line, thread_id, value));
+	}
+
+	// Records dropped so far because the log is full
+	std::size_t dropped_records() const {
+		return sink.dropped_records();
+	}
+};
+
+int main() {
+	MappedLogger mapped_logger;
+
+	// Create a thread that logs through the mapped logger
+	std::thread thread1([&mapped_logger]() {
+		ThreadRegistry::set_current("Thread 1");
+		for (int i = -1; i >= -100; --i) {
+			mapped_logger.log(ThreadRegistry::current(), i);
+		}
+	});
+
+	// Main thread loop
+	ThreadRegistry::set_current("Main Thread");
+	for (int i = 0; i < 100; ++i) {
+		mapped_logger.log(ThreadRegistry::current(), i);
+	}
+
+	// Wait for the thread to finish, the sink truncates on destruction
+	thread1.join();
+	return 0;
+}
+
+/*
+ * Batched log writes through io_uring, with a pwritev fallback
+ */
+
+// Write size bytes at offset, retrying short writes
+void write_all_at(int fd, const char* data, std::size_t size, std::uint64_t offset) {
+	while (size > 0) {
+		const ssize_t written = ::pwrite(fd, data, size, static_cast<off_t>(offset));
+		if (written < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			throw std::system_error(errno, std::generic_category(), "pwrite");
+		}
+		data += written;
+		size -= static_cast<std::size_t>(written);
+		offset += static_cast<std::uint64_t>(written);
+	}
+}
+
+// Flush file data (not necessarily metadata) to the device
+void sync_data(int fd) {
+#if defined(__linux__)
+	const int result = ::fdatasync(fd);
+#else
+	const int result = ::fsync(fd);
+#endif
+	if (result != 0) {
+		throw std::system_error(errno, std::generic_category(), "fdatasync");
+	}
+}
+
+#if defined(HAVE_IO_URING)
+// Minimal io_uring wrapper on top of the raw syscalls
+class IoUring {
+	// Ring file descriptor returned by io_uring_setup
+	int ring_fd = -1;
+	// Sizes and offsets reported by the kernel
+	io_uring_params params{};
+	// Shared memory for the submission ring, completion ring and entries
+	void* sq_ring = MAP_FAILED;
+	std::size_t sq_ring_size = 0;
+	void* cq_ring = MAP_FAILED;
+	std::size_t cq_ring_size = 0;
+	io_uring_sqe* sqes = nullptr;
+	std::size_t sqes_size = 0;
+	// Pointers into the shared rings
+	unsigned* sq_head = nullptr;
+	unsigned* sq_tail = nullptr;
+	unsigned* sq_array = nullptr;
+	unsigned* cq_head = nullptr;
+	unsigned* cq_tail = nullptr;
+	io_uring_cqe* cqes = nullptr;
+	// Tail including prepared but not yet published entries
+	unsigned prepared_tail = 0;
+
+	// Unmap the rings and close the ring descriptor
+	void release() {
+		if (sqes != nullptr) {
+			::munmap(sqes, sqes_size);
+		}
+		if (cq_ring != MAP_FAILED && cq_ring != sq_ring) {
+			::munmap(cq_ring, cq_ring_size);
+		}
+		if (sq_ring != MAP_FAILED) {
+			::munmap(sq_ring, sq_ring_size);
+		}
+		if (ring_fd >= 0) {
+			::close(ring_fd);
+		}
+	}
+
+	// Map one region of the ring, throwing on failure
+	void* map_region(std::size_t size, off_t offset) {
+		void* address = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, offset);
+		if (address == MAP_FAILED) {
+			const int error = errno;
+			release();
+			throw std::system_error(error, std::generic_category(), "mmap io_uring");
+		}
+		return address;
+	}
+
+	// Call io_uring_enter, retrying when interrupted by a signal
+	unsigned enter(unsigned submit_count, unsigned wait_count, unsigned flags) {
+		while (true) {
+			const long result = ::syscall(__NR_io_uring_enter, ring_fd, submit_count, wait_count, flags, nullptr, 0);
+			if (result >= 0) {
+				return static_cast<unsigned>(result);
+			}
+			if (errno != EINTR) {
+				throw std::system_error(errno, std::generic_category(), "io_uring_enter");
+			}
+		}
+	}
+
+public:
+	// Constructor that sets up a ring with room for entries submissions,
+	// throws std::system_error when io_uring is unavailable
+	explicit IoUring(unsigned entries) {
+		ring_fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+		if (ring_fd < 0) {
+			throw std::system_error(errno, std::generic_category(), "io_uring_setup");
+		}
+		sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+		cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+		// Newer kernels map both rings with a single mmap
+		if (params.features & IORING_FEAT_SINGLE_MMAP) {
+			sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+		}
+		sq_ring = map_region(sq_ring_size, IORING_OFF_SQ_RING);
+		cq_ring = (params.features & IORING_FEAT_SINGLE_MMAP) ? sq_ring : map_region(cq_ring_size, IORING_OFF_CQ_RING);
+		sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+		sqes = static_cast<io_uring_sqe*>(map_region(sqes_size, IORING_OFF_SQES));
+
+		char* sq = static_cast<char*>(sq_ring);
+		sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+		sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+		sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+		char* cq = static_cast<char*>(cq_ring);
+		cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+		cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+		cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+		prepared_tail = *sq_tail;
+	}
+
+	// Prevent copying, the ring owns its mappings
+	IoUring(const IoUring&) = delete;
+	IoUring& operator=(const IoUring&) = delete;
+
+	// Destructor that tears the ring down
+	~IoUring() {
+		release();
+	}
+
+	// Return a zeroed submission entry, or nullptr when the ring is full
+	io_uring_sqe* get_sqe() {
+		const unsigned head = std::atomic_ref<unsigned>(*sq_head).load(std::memory_order_acquire);
+		if (prepared_tail - head == params.sq_entries) {
+			return nullptr;
+		}
+		const unsigned index = prepared_tail & (params.sq_entries - 1);
+		sq_array[index] = index;
+		++prepared_tail;
+		std::memset(&sqes[index], 0, sizeof(io_uring_sqe));
+		return &sqes[index];
+	}
+
+	// Publish the prepared entries, submit them and block until
+	// at least wait_count completions are available
+	void submit_and_wait(unsigned submit_count, unsigned wait_count) {
+		std::atomic_ref<unsigned>(*sq_tail).store(prepared_tail, std::memory_order_release);
+		while (submit_count > 0) {
+			submit_count -= enter(submit_count, 0, 0);
+		}
+		enter(0, wait_count, IORING_ENTER_GETEVENTS);
+	}
+
+	// Pass every available completion to func, returns how many were consumed.
+	// Each entry is released to the kernel before func sees it, so a throwing
+	// func does not leave already handled completions in the ring.
+	template <typename Func>
+	unsigned reap(Func func) {
+		unsigned head = *cq_head;
+		const unsigned tail = std::atomic_ref<unsigned>(*cq_tail).load(std::memory_order_acquire);
+		unsigned count = 0;
+		while (head != tail) {
+			const io_uring_cqe cqe = cqes[head & (params.cq_entries - 1)];
+			std::atomic_ref<unsigned>(*cq_head).store(++head, std::memory_order_release);
+			++count;
+			func(cqe);
+		}
+		return count;
+	}
+};
+#endif
+
+class UringLogSink {
+	// Producers fill buffers of this size, the flush thread writes them
+	static constexpr std::size_t buffer_size = 256 * 1024;
+	// Number of buffers: one being filled, the rest queued or in flight
+	static constexpr std::size_t buffer_count = 8;
+	// Longest time a partially filled buffer waits before it is written
+	static constexpr std::chrono::milliseconds flush_interval{1};
+	// Submission queue size: a batch of every buffer plus its fdatasync must fit
+	static constexpr std::size_t ring_entries = buffer_count * 2;
+	static_assert(buffer_count + 1 <= ring_entries, "a whole batch must fit in the submission queue");
+
+	struct Buffer {
+		// Buffer memory
+		std::unique_ptr<char[]> data;
+		// Number of bytes filled
+		std::size_t used = 0;
+	};
+
+	// File descriptor of the log file
+	int fd = -1;
+	// Whether every batch is followed by fdatasync
+	bool durable;
+#if defined(HAVE_IO_URING)
+	// Ring used for batched writes, null when falling back to pwritev
+	std::unique_ptr<IoUring> ring;
+#endif
+	// Mutex protecting the buffer lists, held only for a memcpy
+	std::mutex buffer_mutex;
+	// Signaled when a buffer is full or the sink shuts down
+	std::condition_variable buffer_ready;
+	// Signaled when the flush thread returns buffers
+	std::condition_variable buffer_free;
+	// Every buffer, owned by the sink
+	std::vector<Buffer> buffers;
+	// Empty buffers ready to be filled
+	std::vector<Buffer*> free_buffers;
+	// Buffers waiting to be written, in file order
+	std::vector<Buffer*> full_buffers;
+	// Buffer producers are filling, null while every buffer is busy
+	Buffer* current = nullptr;
+	// Set by the destructor to stop the flush thread
+	bool stopping = false;
+	// First write or sync error of the flush thread, rethrown to producers
+	std::exception_ptr failure;
+	// File offset of the next batch, only used by the flush thread
+	std::uint64_t file_offset = 0;
+	// Thread that submits batches and waits for their completion
+	std::thread flusher;
+
+	// Write a batch with pwritev when io_uring is unavailable
+	void write_batch_pwritev(const std::vector<Buffer*>& batch) {
+		std::vector<iovec> iov;
+		std::size_t total = 0;
+		for (Buffer* buffer : batch) {
+			iov.push_back(iovec{buffer->data.get(), buffer->used});
+			total += buffer->used;
+		}
+		ssize_t written = ::pwritev(fd, iov.data(), static_cast<int>(iov.size()), static_cast<off_t>(file_offset));
+		if (written < 0) {
+			written = 0;
+		}
+		// Finish a short write buffer by buffer
+		std::size_t skip = static_cast<std::size_t>(written);
+		std::uint64_t offset = file_offset;
+		for (Buffer* buffer : batch) {
+			const std::size_t done = std::min(skip, buffer->used);
+			write_all_at(fd, buffer->data.get() + done, buffer->used - done, offset + done);
+			skip -= done;
+			offset += buffer->used;
+		}
+		file_offset += total;
+		if (durable) {
+			sync_data(fd);
+		}
+	}
+
+#if defined(HAVE_IO_URING)
+	// Next submission entry; ring_entries makes room for a whole batch
+	io_uring_sqe& next_sqe() {
+		io_uring_sqe* sqe = ring->get_sqe();
+		if (sqe == nullptr) {
+			throw std::logic_error("io_uring submission queue full");
+		}
+		return *sqe;
+	}
+
+	// Submit one write per buffer plus an optional fdatasync, then wait for all completions
+	void write_batch_uring(const std::vector<Buffer*>& batch) {
+		unsigned submitted = 0;
+		std::uint64_t offset = file_offset;
+		for (Buffer* buffer : batch) {
+			io_uring_sqe& sqe = next_sqe();
+			sqe.opcode = IORING_OP_WRITE;
+			sqe.fd = fd;
+			sqe.addr = reinterpret_cast<std::uint64_t>(buffer->data.get());
+			sqe.len = static_cast<std::uint32_t>(buffer->used);
+			sqe.off = offset;
+			sqe.user_data = submitted;
+			offset += buffer->used;
+			++submitted;
+		}
+		if (durable) {
+			// Drain makes the sync start only after every write above completed
+			io_uring_sqe& sqe = next_sqe();
+			sqe.opcode = IORING_OP_FSYNC;
+			sqe.fd = fd;
+			sqe.fsync_flags = IORING_FSYNC_DATASYNC;
+			sqe.flags = IOSQE_IO_DRAIN;
+			sqe.user_data = submitted;
+			++submitted;
+		}
+		// The producers keep filling other buffers while the kernel writes
+		ring->submit_and_wait(submitted, submitted);
+		unsigned completed = 0;
+		bool sync_needed = false;
+		while (completed < submitted) {
+			completed += ring->reap([&](const io_uring_cqe& cqe) {
+				const auto index = static_cast<std::size_t>(cqe.user_data);
+				if (index == batch.size()) {
+					// A failed fdatasync may already have dropped the dirty pages,
+					// so a retry could succeed without the data ever reaching disk
+					if (cqe.res < 0) {
+						throw std::system_error(-cqe.res, std::generic_category(), "fdatasync");
+					}
+					return;
+				}
+				// Finish a failed or short write synchronously; the sync above may
+				// have run before the rewrite, so it needs one of its own
+				std::uint64_t buffer_offset = file_offset;
+				for (std::size_t i = 0; i < index; ++i) {
+					buffer_offset += batch[i]->used;
+				}
+				const std::size_t done = cqe.res > 0 ? static_cast<std::size_t>(cqe.res) : 0;
+				if (done < batch[index]->used) {
+					write_all_at(fd, batch[index]->data.get() + done, batch[index]->used - done, buffer_offset + done);
+					sync_needed = durable;
+				}
+			});
+			if (completed < submitted) {
+				ring->submit_and_wait(0, submitted - completed);
+			}
+		}
+		file_offset = offset;
+		if (sync_needed) {
+			sync_data(fd);
+		}
+	}
+#endif
+
+	// Flush thread: collect full buffers, write them as one batch, recycle them.
+	// After an error the remaining batches are discarded, but buffers keep
+	// being recycled so producers are never left waiting for a free one.
+	void flush_loop() {
+		std::vector<Buffer*> batch;
+		bool failed = false;
+		while (true) {
+			{
+				std::unique_lock<std::mutex> lock(buffer_mutex);
+				buffer_ready.wait_for(lock, flush_interval, [this]() { return !full_buffers.empty() || stopping; });
+				// Also take a partially filled buffer so records never wait long in memory
+				if (current != nullptr && current->used > 0) {
+					full_buffers.push_back(current);
+					current = nullptr;
+					if (!free_buffers.empty()) {
+						current = free_buffers.back();
+						free_buffers.pop_back();
+					}
+				}
+				batch.swap(full_buffers);
+				if (batch.empty() && stopping) {
+					break;
+				}
+			}
+			if (batch.empty()) {
+				continue;
+			}
+			try {
+				if (!failed) {
+#if defined(HAVE_IO_URING)
+					if (ring) {
+						write_batch_uring(batch);
+					} else {
+						write_batch_pwritev(batch);
+					}
+#else
+					write_batch_pwritev(batch);
+#endif
+				}
+			} catch (...) {
+				failed = true;
+				std::lock_guard<std::mutex> lock(buffer_mutex);
+				failure = std::current_exception();
+			}
+			{
+				std::lock_guard<std::mutex> lock(buffer_mutex);
+				for (Buffer* buffer : batch) {
+					buffer->used = 0;
+					free_buffers.push_back(buffer);
+				}
+			}
+			buffer_free.notify_all();
+			batch.clear();
+		}
+	}
+
+public:
+	// Constructor that opens the file, sets up io_uring if requested and
+	// available, and starts the flush thread
+	UringLogSink(const std::string& path, bool durable_writes = false, bool use_io_uring = true)
+		: durable(durable_writes), buffers(buffer_count) {
+		fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0) {
+			throw std::system_error(errno, std::generic_category(), "open " + path);
+		}
+#if defined(HAVE_IO_URING)
+		if (use_io_uring) {
+			try {
+				ring = std::make_unique<IoUring>(static_cast<unsigned>(ring_entries));
+			} catch (const std::system_error&) {
+				// Kernel without io_uring or blocked by seccomp: use pwritev
+				ring.reset();
+			}
+		}
+#else
+		(void)use_io_uring;
+#endif
+		for (Buffer& buffer : buffers) {
+			buffer.data = std::make_unique<char[]>(buffer_size);
+			free_buffers.push_back(&buffer);
+		}
+		current = free_buffers.back();
+		free_buffers.pop_back();
+		flusher = std::thread(&UringLogSink::flush_loop, this);
+	}
+
+	// Prevent copying, the sink owns its buffers and thread
+	UringLogSink(const UringLogSink&) = delete;
+	UringLogSink& operator=(const UringLogSink&) = delete;
+
+	// Destructor that writes the remaining data and closes the file.
+	// Every producer must have finished before the sink is destroyed.
+	~UringLogSink() {
+		{
+			std::lock_guard<std::mutex> lock(buffer_mutex);
+			stopping = true;
+		}
+		buffer_ready.notify_one();
+		flusher.join();
+		::close(fd);
+		if (failure) {
+			std::cerr << "UringLogSink: records after a failed write were discarded" << std::endl;
+		}
+	}
+
+	// True when batches go through io_uring rather than pwritev
+	bool uses_io_uring() const {
+#if defined(HAVE_IO_URING)
+		return ring != nullptr;
+#else
+		return false;
+#endif
+	}
+
+	// Copy one record into the current buffer, blocks only when every buffer is busy.
+	// Rethrows the flush thread's error once a write or sync has failed.
+	void append(const char* data, std::size_t size) {
+		std::unique_lock<std::mutex> lock(buffer_mutex);
+		while (current == nullptr || current->used + size > buffer_size) {
+			if (failure) {
+				std::rethrow_exception(failure);
+			}
+			// Hand the full buffer to the flush thread
+			if (current != nullptr) {
+				full_buffers.push_back(current);
+				current = nullptr;
+				buffer_ready.notify_one();
+			}
+			buffer_free.wait(lock, [this]() { return !free_buffers.empty() || current != nullptr; });
+			if (current == nullptr) {
+				current = free_buffers.back();
+				free_buffers.pop_back();
+			}
+		}
+		if (failure) {
+			std::rethrow_exception(failure);
+		}
+		std::memcpy(current->data.get() + current->used, data, size);
+		current->used += size;
+	}
+
+	// Function to log data in today's text format, throws once the sink has failed
+	void log(ThreadHandle thread_id, int value) {
+		char line[128];
+		append(line, format_record_line(line, thread_id, value));
+	}
+};
+
+int main() {
+	// Compare the ofstream + endl path with batched writes
+	const int thread_count = 4;
+	const int records_per_thread = 100000;
+	const double records = static_cast<double>(thread_count) * records_per_thread;
+
+	{
+		TextLogger text_logger;
+		const double seconds = time_log_calls(thread_count, records_per_thread,
+			[&text_logger](const std::string& id, int value) { text_logger.log(id, value); });
+		std::cout << "ofstream + endl: " << seconds * 1e9 / records << " ns/record" << std::endl;
+	}
+	for (const bool use_io_uring : {true, false}) {
+		for (const bool durable : {false, true}) {
+			bool uring_active = false;
+			// Time until the sink is destroyed so the final flush is included
+			const auto start = std::chrono::steady_clock::now();
+			{
+				UringLogSink sink("uring_log.txt", durable, use_io_uring);
+				uring_active = sink.uses_io_uring();
+				time_log_calls(thread_count, records_per_thread,
+					[&sink](const std::string&, int value) { sink.log(ThreadRegistry::current(), value); });
+			}
+			const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+			std::cout << (uring_active ? "io_uring" : "pwritev") << (durable ? " + fdatasync" : "") << ": "
+				<< elapsed.count() * 1e9 / records << " ns/record" << std::endl;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Group commit: one write + fdatasync releases a whole group of durable records
+ */
+
+// Ticket returned by a durable log call, redeemed with wait_durable()
+struct CommitTicket {
+	// Sequence number of the record, records commit in sequence order
+	std::uint64_t sequence;
+};
+
+class GroupCommitLogger {
+	// File descriptor of the log file
+	int fd = -1;
+	// How long a group stays open after its first record arrives
+	std::chrono::microseconds commit_window;
+	// A group is committed early once it holds this many bytes
+	std::size_t max_group_bytes;
+	// Mutex protecting everything below
+	std::mutex commit_mutex;
+	// Signaled when a group opens, fills up or the logger shuts down
+	std::condition_variable work_ready;
+	// Signaled when a group has become durable
+	std::condition_variable durable_ready;
+	// Formatted records of the open group
+	std::string pending;
+	// Arrival time of the first record in the open group
+	std::chrono::steady_clock::time_point group_start;
+	// Sequence of the last appended record
+	std::uint64_t appended_sequence = 0;
+	// Every record up to this sequence is on disk
+	std::uint64_t durable_sequence = 0;
+	// Number of fdatasync calls issued so far
+	std::uint64_t syncs = 0;
+	// Set by the destructor to stop the commit thread
+	bool stopping = false;
+	// First write or sync error of the commit thread; records after
+	// durable_sequence will never become durable once it is set
+	std::exception_ptr failure;
+	// File offset of the next group, only used by the commit thread
+	std::uint64_t file_offset = 0;
+	// Thread that writes and syncs each group
+	std::thread committer;
+
+	// Commit thread: wait for the window to close, then write + sync the group.
+	// On an error it records the failure, releases every waiter and stops.
+	void commit_loop() {
+		std::string group;
+		std::unique_lock<std::mutex> lock(commit_mutex);
+		while (true) {
+			work_ready.wait(lock, [this]() { return !pending.empty() || stopping; });
+			if (pending.empty()) {
+				break;
+			}
+			// Keep the group open for the window unless it is already large enough
+			work_ready.wait_until(lock, group_start + commit_window,
+				[this]() { return pending.size() >= max_group_bytes || stopping; });
+			group.swap(pending);
+			const std::uint64_t group_end = appended_sequence;
+			// New records open the next group while this one is on its way to disk
+			lock.unlock();
+			try {
+				write_all_at(fd, group.data(), group.size(), file_offset);
+				file_offset += group.size();
+				sync_data(fd);
+			} catch (...) {
+				lock.lock();
+				failure = std::current_exception();
+				pending.clear();
+				durable_ready.notify_all();
+				break;
+			}
+			group.clear();
+			lock.lock();
+			durable_sequence = group_end;
+			++syncs;
+			// Release every waiter of the group together
+			durable_ready.notify_all();
+		}
+	}
+
+public:
+	// Constructor that opens the log file and starts the commit thread
+	GroupCommitLogger(const std::string& path = "group_commit_log.txt",
+		std::chrono::microseconds window = std::chrono::microseconds(2000),
+		std::size_t max_bytes = std::size_t{1} << 20)
+		: commit_window(window), max_group_bytes(max_bytes) {
+		fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0) {
+			throw std::system_error(errno, std::generic_category(), "open " + path);
+		}
+		committer = std::thread(&GroupCommitLogger::commit_loop, this);
+	}
+
+	// Prevent copying, the logger owns its file and thread
+	GroupCommitLogger(const GroupCommitLogger&) = delete;
+	GroupCommitLogger& operator=(const GroupCommitLogger&) = delete;
+
+	// Destructor that commits the last group and closes the file
+	~GroupCommitLogger() {
+		{
+			std::lock_guard<std::mutex> lock(commit_mutex);
+			stopping = true;
+		}
+		work_ready.notify_one();
+		committer.join();
+		::close(fd);
+	}
+
+	// Function to log data durably, returns immediately with a ticket.
+	// Throws the commit thread's error once a write or sync has failed.
+	CommitTicket log_durable(ThreadHandle thread_id, int value) {
+		// Format outside the critical section
+		char line[128];
+		const std::size_t length = format_record_line(line, thread_id, value);
+		std::lock_guard<std::mutex> lock(commit_mutex);
+		if (failure) {
+			std::rethrow_exception(failure);
+		}
+		if (pending.empty()) {
+			// First record of a new group starts the commit window
+			group_start = std::chrono::steady_clock::now();
+			work_ready.notify_one();
+		}
+		pending.append(line, length);
+		if (pending.size() >= max_group_bytes) {
+			work_ready.notify_one();
+		}
+		return CommitTicket{++appended_sequence};
+	}
+
+	// Block until the record behind ticket is on disk, throws the commit
+	// thread's error if the record's group failed to commit
+	void wait_durable(CommitTicket ticket) {
+		std::unique_lock<std::mutex> lock(commit_mutex);
+		durable_ready.wait(lock, [this, ticket]() { return durable_sequence >= ticket.sequence || failure; });
+		if (durable_sequence < ticket.sequence) {
+			std::rethrow_exception(failure);
+		}
+	}
+
+	// Number of fdatasync calls issued so far
+	std::uint64_t sync_count() {
+		std::lock_guard<std::mutex> lock(commit_mutex);
+		return syncs;
+	}
+};
+
+int main() {
+	const int thread_count = 16;
+	const int records_per_thread = 500;
+	const auto start = std::chrono::steady_clock::now();
+	std::uint64_t syncs = 0;
+	{
+		GroupCommitLogger group_logger;
+		std::vector<std::thread> threads;
+		for (int t = 0; t < thread_count; ++t) {
+			threads.emplace_back([&group_logger, t]() {
+				ThreadRegistry::set_current("Thread " + std::to_string(t));
+				for (int i = 0; i < records_per_thread; ++i) {
+					// Each record is durable before the thread moves on
+					group_logger.wait_durable(group_logger.log_durable(ThreadRegistry::current(), i));
+				}
+			});
+		}
+		for (auto& thread : threads) {
+			thread.join();
+		}
+		syncs = group_logger.sync_count();
+	}
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	// Without group commit every record would need its own fdatasync
+	const int records = thread_count * records_per_thread;
+	std::cout << records << " durable records, " << syncs << " fdatasync calls, "
+		<< static_cast<double>(records) / static_cast<double>(syncs) << " records/sync, "
+		<< static_cast<double>(syncs) / elapsed.count() << " syncs/sec, "
+		<< static_cast<double>(records) / elapsed.count() << " durable records/sec" << std::endl;
+	return 0;
+}
+
+/*
+ * Sharded per-thread log files with a k-way timestamp merge
+ */
+
+// Every shard starts with this 8-byte magic
+constexpr char shard_magic[8] = {'C', 'L', 'O', 'G', 'S', 'H', 'D', '1'};
+
+// Fixed 64-byte header naming the thread that owns the shard
+struct ShardHeader {
+	char magic[8];
+	// Length of the thread name, truncated to fit
+	std::uint32_t name_length;
+	char name[52];
+};
+
+// Fixed-size record, records in a shard are ordered by timestamp
+struct ShardRecord {
+	// Steady clock nanoseconds, monotonic and shared by every process on the machine
+	std::uint64_t timestamp_ns;
+	// Per-shard sequence number, breaks ties between equal timestamps
+	std::uint64_t sequence;
+	// Value to log
+	std::int32_t value;
+	std::uint32_t reserved;
+};
+
+// Current steady clock time in nanoseconds
+std::uint64_t steady_now_ns() {
+	return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+class ShardedLogger {
+	struct Shard {
+		// Large stream buffer so the shard is written in big blocks
+		std::vector<char> stream_buffer;
+		// Shard file stream, written by its owning thread and flushed by the flush thread
+		std::ofstream file;
+		// Sequence number of the next record
+		std::uint64_t next_sequence = 0;
+		// Guards file; the flush thread takes it once per interval, so the
+		// owning thread almost always finds it uncontended
+		std::mutex mutex;
+	};
+
+	// Shard files are named <prefix><index>.bin
+	std::string prefix;
+	// Mutex taken only when a thread logs for the first time
+	std::mutex shards_mutex;
+	// One shard per thread that has logged through this logger
+	std::vector<std::unique_ptr<Shard>> shards;
+	// Paths of every shard, in creation order
+	std::vector<std::string> paths;
+	// The calling thread's shard, looked up without a lock
+	ThreadSlots<Shard> shard_slots;
+	// Every shard is flushed at least this often, which bounds how far a
+	// shard file lags behind its writer (tail_shards relies on it)
+	const std::chrono::milliseconds flush_interval;
+	// Signaled by the destructor to stop the flush thread
+	std::condition_variable flush_wake;
+	// Set by the destructor, protected by shards_mutex
+	bool stopping = false;
+	// Thread that periodically pushes buffered records of quiet shards to their files
+	std::thread flusher;
+
+	// Flush thread: flush every shard once per interval until the logger is
+	// destroyed. The file I/O runs without shards_mutex, so a thread creating
+	// its shard never waits for other shards to be flushed.
+	void flush_loop() {
+		std::vector<Shard*> snapshot;
+		std::unique_lock<std::mutex> lock(shards_mutex);
+		while (!flush_wake.wait_for(lock, flush_interval, [this]() { return stopping; })) {
+			// Shards are only removed by the destructor, after this thread has stopped
+			snapshot.clear();
+			for (const auto& shard : shards) {
+				snapshot.push_back(shard.get());
+			}
+			lock.unlock();
+			for (Shard* shard : snapshot) {
+				std::lock_guard<std::mutex> shard_lock(shard->mutex);
+				shard->file.flush();
+			}
+			lock.lock();
+		}
+	}
+
+	// Return the calling thread's shard, creating its file on first use
+	Shard& local_shard() {
+		return shard_slots.local([this]() {
+			std::lock_guard<std::mutex> lock(shards_mutex);
+			auto shard = std::make_unique<Shard>();
+			shard->stream_buffer.resize(1 << 16);
+			shard->file.rdbuf()->pubsetbuf(shard->stream_buffer.data(),
+				static_cast<std::streamsize>(shard->stream_buffer.size()));
+			paths.push_back(prefix + std::to_string(shards.size()) + ".bin");
+			shard->file.open(paths.back(), std::ios::binary | std::ios::trunc);
+			// The header names the shard after the thread that owns it
+			ShardHeader header{};
+			std::memcpy(header.magic, shard_magic, sizeof(shard_magic));
+			const std::string_view name = ThreadRegistry::name(ThreadRegistry::current());
+			header.name_length = static_cast<std::uint32_t>(std::min(name.size(), sizeof(header.name)));
+			std::memcpy(header.name, name.data(), header.name_length);
+			shard->file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			shards.push_back(std::move(shard));
+			return shards.back().get();
+		});
+	}
+
+public:
+	// Constructor that sets the shard file prefix and starts the flush thread,
+	// shards are created lazily
+	ShardedLogger(const std::string& shard_prefix = "shard_",
+		std::chrono::milliseconds interval = std::chrono::milliseconds(50))
+		: prefix(shard_prefix), flush_interval(interval) {
+		flusher = std::thread(&ShardedLogger::flush_loop, this);
+	}
+
+	// Prevent copying, the logger owns its shards and thread
+	ShardedLogger(const ShardedLogger&) = delete;
+	ShardedLogger& operator=(const ShardedLogger&) = delete;
+
+	// Destructor that stops the flush thread, the shard streams flush as they close
+	~ShardedLogger() {
+		{
+			std::lock_guard<std::mutex> lock(shards_mutex);
+			stopping = true;
+		}
+		flush_wake.notify_one();
+		flusher.join();
+	}
+
+	// Function to log data for the calling thread, only its own shard's lock on the hot path
+	void log(int value) {
+		Shard& shard = local_shard();
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		// Timestamp under the lock, so a record is in the file within one flush interval of it
+		const ShardRecord record{steady_now_ns(), shard.next_sequence++, value, 0};
+		shard.file.write(reinterpret_cast<const char*>(&record), sizeof(record));
+	}
+
+	// Paths of the shards created so far
+	std::vector<std::string> shard_paths() {
+		std::lock_guard<std::mutex> lock(shards_mutex);
+		return paths;
+	}
+};
+
+// Read-only memory mapping of one shard file
+class MappedShard {
+	// Start of the mapping, or nullptr for an empty file
+	void* mapping = nullptr;
+	// Size of the mapping in bytes
+	std::size_t size = 0;
+
+public:
+	// Constructor that maps the shard and validates its header
+	explicit MappedShard(const std::string& path) {
+		const int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0) {
+			throw std::system_error(errno, std::generic_category(), "open " + path);
+		}
+		struct stat info;
+		int map_error = 0;
+		if (::fstat(fd, &info) == 0 && info.st_size > 0) {
+			size = static_cast<std::size_t>(info.st_size);
+			mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+			// close() below may overwrite errno
+			map_error = errno;
+		}
+		::close(fd);
+		if (mapping == MAP_FAILED) {
+			throw std::system_error(map_error, std::generic_category(), "mmap " + path);
+		}
+		if (size < sizeof(ShardHeader) || std::memcmp(header().magic, shard_magic, sizeof(shard_magic)) != 0) {
+			release();
+			throw std::runtime_error("not a shard file: " + path);
+		}
+	}
+
+	// Prevent copying, moving keeps exactly one owner of the mapping
+	MappedShard(const MappedShard&) = delete;
+	MappedShard& operator=(const MappedShard&) = delete;
+	MappedShard(MappedShard&& other) noexcept
+		: mapping(std::exchange(other.mapping, nullptr)), size(std::exchange(other.size, 0)) {}
+
+	// Destructor that unmaps the shard
+	~MappedShard() {
+		release();
+	}
+
+	// Unmap the shard
+	void release() {
+		if (mapping != nullptr) {
+			::munmap(mapping, size);
+			mapping = nullptr;
+		}
+	}
+
+	const ShardHeader& header() const {
+		return *static_cast<const ShardHeader*>(mapping);
+	}
+
+	// Name of the thread that wrote the shard
+	std::string_view name() const {
+		return std::string_view(header().name, std::min<std::size_t>(header().name_length, sizeof(header().name)));
+	}
+
+	// First record, records follow the header back to back
+	const ShardRecord* begin() const {
+		return reinterpret_cast<const ShardRecord*>(static_cast<const char*>(mapping) + sizeof(ShardHeader));
+	}
+
+	// One past the last complete record, a torn trailing record is ignored
+	const ShardRecord* end() const {
+		return begin() + (size - sizeof(ShardHeader)) / sizeof(ShardRecord);
+	}
+};
+
+// Range of records still to be merged from one shard
+struct MergeCursor {
+	const ShardRecord* next;
+	const ShardRecord* end;
+};
+
+// Tournament (loser) tree over k cursors: each internal node stores the loser
+// of its match, so advancing the winner replays only one leaf-to-root path
+class LoserTree {
+	// Cursors being merged, indexed by source
+	std::vector<MergeCursor>& cursors;
+	// losers[0] holds the overall winner, losers[1..k-1] the match losers
+	std::vector<std::size_t> losers;
+
+	// True if source a must be emitted before source b
+	bool before(std::size_t a, std::size_t b) const {
+		const MergeCursor& x = cursors[a];
+		const MergeCursor& y = cursors[b];
+		if (x.next == x.end) {
+			return false;
+		}
+		if (y.next == y.end) {
+			return true;
+		}
+		if (x.next->timestamp_ns != y.next->timestamp_ns) {
+			return x.next->timestamp_ns < y.next->timestamp_ns;
+		}
+		// Equal timestamps: order by shard, records within a shard are already in sequence order
+		return a < b;
+	}
+
+	// Play the matches below node and return the winner of that subtree
+	std::size_t build(std::size_t node) {
+		if (node >= cursors.size()) {
+			return node - cursors.size();
+		}
+		const std::size_t left = build(2 * node);
+		const std::size_t right = build(2 * node + 1);
+		if (before(left, right)) {
+			losers[node] = right;
+			return left;
+		}
+		losers[node] = left;
+		return right;
+	}
+
+public:
+	// Constructor that plays the initial tournament
+	explicit LoserTree(std::vector<MergeCursor>& merge_cursors)
+		: cursors(merge_cursors), losers(std::max<std::size_t>(merge_cursors.size(), 1)) {
+		if (!cursors.empty()) {
+			losers[0] = build(1);
+		}
+	}
+
+	// Source holding the smallest record
+	std::size_t winner() const {
+		return losers[0];
+	}
+
+	// True once every cursor is exhausted
+	bool empty() const {
+		return cursors.empty() || cursors[losers[0]].next == cursors[losers[0]].end;
+	}
+
+	// Consume the winning record and replay its path to the root
+	const ShardRecord& pop() {
+		std::size_t source = losers[0];
+		const ShardRecord& record = *cursors[source].next++;
+		for (std::size_t node = (source + cursors.size()) / 2; node >= 1; node /= 2) {
+			if (before(losers[node], source)) {
+				std::swap(losers[node], source);
+			}
+		}
+		losers[0] = source;
+		return record;
+	}
+};
+
+// Merge shards into one timestamp-ordered text log. The timestamp range is
+// split into chunk_count chunks that are merged and formatted in parallel,
+// then written in order.
+void merge_shards(const std::vector<std::string>& shard_paths, const std::string& output_path,
+	unsigned chunk_count = std::max(1u, std::thread::hardware_concurrency())) {
+	std::vector<MappedShard> shards;
+	for (const auto& path : shard_paths) {
+		shards.emplace_back(path);
+	}
+
+	// Sample timestamps and pick chunk boundaries at their quantiles
+	std::vector<std::uint64_t> samples;
+	for (const auto& shard : shards) {
+		for (const ShardRecord* record = shard.begin(); record < shard.end(); record += 256) {
+			samples.push_back(record->timestamp_ns);
+		}
+	}
+	std::sort(samples.begin(), samples.end());
+	std::vector<std::uint64_t> splits;
+	for (unsigned c = 1; c < chunk_count && !samples.empty(); ++c) {
+		splits.push_back(samples[samples.size() * c / chunk_count]);
+	}
+	splits.push_back(UINT64_MAX);
+
+	// Record prefix of every shard, built once instead of per merged record
+	std::vector<std::string> prefixes;
+	for (const auto& shard : shards) {
+		prefixes.push_back("From " + std::string(shard.name()) + ": ");
+	}
+
+	// Each chunk covers [splits[c - 1], splits[c]) in every shard
+	std::vector<std::string> chunks(splits.size());
+	std::vector<std::thread> workers;
+	for (std::size_t c = 0; c < splits.size(); ++c) {
+		workers.emplace_back([&shards, &prefixes, &splits, &chunks, c]() {
+			const auto by_timestamp = [](const ShardRecord& record, std::uint64_t timestamp) {
+				return record.timestamp_ns < timestamp;
+			};
+			std::vector<MergeCursor> cursors;
+			for (const auto& shard : shards) {
+				const ShardRecord* first = c == 0 ? shard.begin()
+					: std::lower_bound(shard.begin(), shard.end(), splits[c - 1], by_timestamp);
+				const ShardRecord* last = c + 1 == splits.size() ? shard.end()
+					: std::lower_bound(shard.begin(), shard.end(), splits[c], by_timestamp);
+				cursors.push_back(MergeCursor{first, last});
+			}
+			LoserTree tree(cursors);
+			std::string& output = chunks[c];
+			char line[128];
+			while (!tree.empty()) {
+				const std::size_t source = tree.winner();
+				const ShardRecord& record = tree.pop();
+				output.append(line, format_line(line, prefixes[source], record.value));
+			}
+		});
+	}
+	for (auto& worker : workers) {
+		worker.join();
+	}
+
+	std::ofstream output(output_path, std::ios::binary | std::ios::trunc);
+	for (const auto& chunk : chunks) {
+		output.write(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+	}
+}
+
+int main() {
+	std::vector<std::string> shard_paths;
+	{
+		ShardedLogger sharded_logger;
+		std::vector<std::thread> threads;
+		for (int t = 0; t < 4; ++t) {
+			threads.emplace_back([&sharded_logger, t]() {
+				ThreadRegistry::set_current("Thread " + std::to_string(t));
+				for (int i = 0; i < 100000; ++i) {
+					sharded_logger.log(i);
+				}
+			});
+		}
+		for (auto& thread : threads) {
+			thread.join();
+		}
+		shard_paths = sharded_logger.shard_paths();
+	}
+
+	// Merge the shards offline into one ordered stream
+	merge_shards(shard_paths, "merged_log.txt");
+	return 0;
+}
+
+/*
+ * Tailing: merge shards on the fly while they are still being written
+ */
+
+// Follow growing shards and print records in timestamp order until stop is set.
+// A record is printed once every shard is known to have moved past its
+// timestamp; an idle shard is assumed to be at most lag behind the clock.
+// That holds only if writers flush more often than lag: ShardedLogger
+// flushes every 50 ms by default, so keep lag above its flush interval.
+void tail_shards(const std::vector<std::string>& shard_paths, std::ostream& output,
+	const std::atomic<bool>& stop, std::chrono::milliseconds lag = std::chrono::milliseconds(100)) {
+	struct TailedShard {
+		std::ifstream file;
+		std::string name;
+		// Timestamp of the last record read, records only move forward
+		std::uint64_t last_timestamp = 0;
+		bool header_read = false;
+	};
+	// Pending record with the shard it came from, ordered for a min-heap
+	struct Pending {
+		ShardRecord record;
+		std::size_t shard;
+		bool operator>(const Pending& other) const {
+			if (record.timestamp_ns != other.record.timestamp_ns) {
+				return record.timestamp_ns > other.record.timestamp_ns;
+			}
+			if (shard != other.shard) {
+				return shard > other.shard;
+			}
+			return record.sequence > other.record.sequence;
+		}
+	};
+
+	std::vector<TailedShard> shards(shard_paths.size());
+	std::priority_queue<Pending, std::vector<Pending>, std::greater<Pending>> pending;
+	const auto lag_ns = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(lag).count());
+	char line[128];
+	while (true) {
+		const bool stopping = stop.load();
+		// Read every complete record that has appeared since the last pass
+		for (std::size_t s = 0; s < shards.size(); ++s) {
+			TailedShard& shard = shards[s];
+			if (!shard.file.is_open()) {
+				shard.file.open(shard_paths[s], std::ios::binary);
+			}
+			while (shard.file.is_open()) {
+				const std::streampos position = shard.file.tellg();
+				ShardHeader header;
+				ShardRecord record;
+				const bool complete = shard.header_read
+					? static_cast<bool>(shard.file.read(reinterpret_cast<char*>(&record), sizeof(record)))
+					: static_cast<bool>(shard.file.read(reinterpret_cast<char*>(&header), sizeof(header)));
+				if (!complete) {
+					// Partial data: rewind and retry once the writer has flushed more
+					shard.file.clear();
+					shard.file.seekg(position);
+					break;
+				}
+				if (!shard.header_read) {
+					shard.name.assign(header.name, std::min<std::size_t>(header.name_length, sizeof(header.name)));
+					shard.header_read = true;
+					continue;
+				}
+				shard.last_timestamp = record.timestamp_ns;
+				pending.push(Pending{record, s});
+			}
+		}
+		// Every future record of a shard is at or after its watermark
+		const std::uint64_t idle_bound = steady_now_ns() - lag_ns;
+		std::uint64_t watermark = UINT64_MAX;
+		for (const auto& shard : shards) {
+			watermark = std::min(watermark, std::max(shard.last_timestamp, idle_bound));
+		}
+		while (!pending.empty() && (stopping || pending.top().record.timestamp_ns <= watermark)) {
+			const Pending& top = pending.top();
+			output.write(line, static_cast<std::streamsize>(
+				format_line(line, "From " + shards[top.shard].name + ": ", top.record.value)));
+			pending.pop();
+		}
+		output.flush();
+		if (stopping) {
+			break;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+}
+
+int main() {
+	std::atomic<bool> stop{false};
+	std::ofstream output("tailed_log.txt");
+	std::thread tail;
+	{
+		ShardedLogger sharded_logger("tail_shard_");
+		std::vector<std::thread> threads;
+		for (int t = 0; t < 4; ++t) {
+			threads.emplace_back([&sharded_logger, t]() {
+				ThreadRegistry::set_current("Thread " + std::to_string(t));
+				for (int i = 0; i < 50000; ++i) {
+					sharded_logger.log(i);
+				}
+			});
+		}
+		// Wait until every writer has created its shard, then follow them
+		while (sharded_logger.shard_paths().size() < 4) {
+			std::this_thread::yield();
+		}
+		tail = std::thread([paths = sharded_logger.shard_paths(), &output, &stop]() {
+			tail_shards(paths, output, stop);
+		});
+		for (auto& thread : threads) {
+			thread.join();
+		}
+	}
+	// The logger flushed its shards on destruction, the final pass picks up the rest
+	stop.store(true);
+	tail.join();
+	return 0;
+}
+
+/*
+ * Amortizing the lock: batches built on DeferredLogger::transfer_lock
+ */
+
+// DeferredLogger from thread_synchronization_example.cpp, extended so that a
+// lock obtained from transfer_lock() can write many records at once
+class BatchingLogger {
+	// Mutex to protect the log file
+	std::mutex file_mutex;
+	// Log file stream
+	std::ofstream log_file;
+	// Number of times file_mutex was acquired, for the benchmark
+	std::atomic<std::uint64_t> acquisitions{0};
+
+	// Per-thread buffer for log_batched(), owned by the logger
+	struct ThreadBatch {
+		std::string buffer;
+		// Arrival time of the oldest buffered record
+		std::chrono::steady_clock::time_point first_record;
+		// Guards the batch; taken by the owning thread per record and by the
+		// flush thread once per tick, so it is almost always uncontended
+		std::mutex mutex;
+	};
+	// Mutex taken only when a thread auto-batches for the first time
+	std::mutex batches_mutex;
+	// One batch per thread that has called log_batched()
+	std::vector<std::unique_ptr<ThreadBatch>> batches;
+	// The calling thread's batch, looked up without a lock
+	ThreadSlots<ThreadBatch> batch_slots;
+	// Auto-batches are flushed once they hold this many bytes
+	std::size_t max_batch_bytes;
+	// ... or once their oldest record is this old
+	std::chrono::microseconds max_batch_delay;
+	// Signaled by the destructor to stop the flush thread
+	std::condition_variable flush_wake;
+	// Set by the destructor, protected by batches_mutex
+	bool stopping = false;
+	// Thread that flushes batches of threads that stopped logging
+	std::thread flusher;
+
+	// Return the calling thread's auto-batch, registering one on first use
+	ThreadBatch& local_batch() {
+		return batch_slots.local([this]() {
+			std::lock_guard<std::mutex> lock(batches_mutex);
+			batches.push_back(std::make_unique<ThreadBatch>());
+			batches.back()->buffer.reserve(max_batch_bytes + 128);
+			return batches.back().get();
+		});
+	}
+
+	// Flush thread: every half delay, flush each batch whose oldest record has
+	// waited at least half the delay. An idle thread's partial batch is then
+	// written within max_batch_delay even though no further record arrives.
+	// A ready batch is swapped out under its lock and written after unlocking,
+	// so its thread keeps appending while the write is in progress.
+	void flush_loop() {
+		const auto tick = std::max<std::chrono::microseconds>(max_batch_delay / 2, std::chrono::microseconds(1));
+		std::vector<ThreadBatch*> snapshot;
+		std::string ready;
+		ready.reserve(max_batch_bytes + 128);
+		std::unique_lock<std::mutex> lock(batches_mutex);
+		while (!flush_wake.wait_for(lock, tick, [this]() { return stopping; })) {
+			// Batches are only removed by the destructor, after this thread has stopped
+			snapshot.clear();
+			for (const auto& batch : batches) {
+				snapshot.push_back(batch.get());
+			}
+			lock.unlock();
+			const auto now = std::chrono::steady_clock::now();
+			bool flushed = false;
+			for (ThreadBatch* batch : snapshot) {
+				std::unique_lock<std::mutex> batch_lock(batch->mutex);
+				if (batch->buffer.empty() || now - batch->first_record < tick) {
+					continue;
+				}
+				ready.swap(batch->buffer);
+				// Take the file before releasing the batch, so a flush by its
+				// own thread cannot overtake these records
+				std::unique_lock<std::mutex> file_lock = transfer_lock();
+				batch_lock.unlock();
+				write_locked(file_lock, ready.data(), ready.size());
+				ready.clear();
+				flushed = true;
+			}
+			// Push the records past the stream buffer as well, or the bound means little
+			if (flushed) {
+				std::unique_lock<std::mutex> file_lock = transfer_lock();
+				log_file.flush();
+			}
+			lock.lock();
+		}
+	}
+
+	// Emit a thread batch with one lock acquisition and one write, called with batch.mutex held
+	void flush_batch(ThreadBatch& batch) {
+		if (batch.buffer.empty()) {
+			return;
+		}
+		std::unique_lock<std::mutex> lock = transfer_lock();
+		write_locked(lock, batch.buffer.data(), batch.buffer.size());
+		batch.buffer.clear();
+	}
+
+public:
+	// Constructor that opens the log file
+	BatchingLogger(std::size_t batch_bytes = 4096,
+		std::chrono::microseconds batch_delay = std::chrono::microseconds(1000))
+		: max_batch_bytes(batch_bytes), max_batch_delay(batch_delay) {
+		log_file.open("batched_log.txt");
+		flusher = std::thread(&BatchingLogger::flush_loop, this);
+	}
+
+	// Prevent copying, the logger owns its batches and thread
+	BatchingLogger(const BatchingLogger&) = delete;
+	BatchingLogger& operator=(const BatchingLogger&) = delete;
+
+	// Destructor that stops the flush thread and flushes every remaining auto-batch.
+	// Every logging thread must have finished before the logger is destroyed.
+	~BatchingLogger() {
+		{
+			std::lock_guard<std::mutex> lock(batches_mutex);
+			stopping = true;
+		}
+		flush_wake.notify_one();
+		flusher.join();
+		for (const auto& batch : batches) {
+			std::lock_guard<std::mutex> batch_lock(batch->mutex);
+			flush_batch(*batch);
+		}
+	}
+
+	// Function to log one record, one lock acquisition per call
+	void log_data(ThreadHandle thread_id, int value) {
+		char line[128];
+		const std::size_t length = format_record_line(line, thread_id, value);
+		std::unique_lock<std::mutex> lock = transfer_lock();
+		write_locked(lock, line, length);
+	}
+
+	// Function to transfer mutex ownership
+	std::unique_lock<std::mutex> transfer_lock() {
+		acquisitions.fetch_add(1, std::memory_order_relaxed);
+		return std::unique_lock<std::mutex>(file_mutex);
+	}
+
+	// Write pre-formatted records, the caller proves it holds the lock
+	void write_locked(const std::unique_lock<std::mutex>& lock, const char* data, std::size_t size) {
+		if (lock.mutex() != &file_mutex || !lock.owns_lock()) {
+			throw std::logic_error("write_locked() requires a lock from transfer_lock()");
+		}
+		log_file.write(data, static_cast<std::streamsize>(size));
+	}
+
+	// Function to log through the calling thread's batch, flushed once it
+	// reaches max_batch_bytes or its oldest record is older than max_batch_delay
+	// (by the next call here, or by the flush thread if the thread goes quiet)
+	void log_batched(ThreadHandle thread_id, int value) {
+		ThreadBatch& batch = local_batch();
+		std::lock_guard<std::mutex> lock(batch.mutex);
+		const auto now = std::chrono::steady_clock::now();
+		if (batch.buffer.empty()) {
+			batch.first_record = now;
+		}
+		char line[128];
+		batch.buffer.append(line, format_record_line(line, thread_id, value));
+		if (batch.buffer.size() >= max_batch_bytes || now - batch.first_record >= max_batch_delay) {
+			flush_batch(batch);
+		}
+	}
+
+	// Flush the calling thread's auto-batch, e.g. before the thread goes idle
+	void flush_thread_batch() {
+		ThreadBatch& batch = local_batch();
+		std::lock_guard<std::mutex> lock(batch.mutex);
+		flush_batch(batch);
+	}
+
+	// Number of times the file mutex has been acquired
+	std::uint64_t lock_acquisitions() const {
+		return acquisitions.load(std::memory_order_relaxed);
+	}
+};
+
+// Explicit batch: records are appended to one contiguous buffer without the
+// lock, and the destructor takes the lock once and emits a single write
+class LogBatch {
+	// Logger the batch is written to
+	BatchingLogger& logger;
+	// Formatted records
+	std::string buffer;
+
+public:
+	// Constructor that reserves room for the expected batch size
+	explicit LogBatch(BatchingLogger& log, std::size_t expected_records = 64) : logger(log) {
+		buffer.reserve(expected_records * 32);
+	}
+
+	// Prevent copying, a batch is written exactly once
+	LogBatch(const LogBatch&) = delete;
+	LogBatch& operator=(const LogBatch&) = delete;
+
+	// Destructor that writes the whole batch under one lock acquisition
+	~LogBatch() {
+		if (!buffer.empty()) {
+			std::unique_lock<std::mutex> lock = logger.transfer_lock();
+			logger.write_locked(lock, buffer.data(), buffer.size());
+		}
+	}
+
+	// Append one record to the batch
+	void add(ThreadHandle thread_id, int value) {
+		char line[128];
+		buffer.append(line, format_record_line(line, thread_id, value));
+	}
+};
+
+int main() {
+	const int thread_count = 4;
+	const int records_per_thread = 102400;
+	const double records = static_cast<double>(thread_count) * records_per_thread;
+
+	// Same workload three ways: one lock per record, explicit batches of 64, auto-batches
+	for (int mode = 0; mode < 3; ++mode) {
+		std::uint64_t acquisitions = 0;
+		const auto start = std::chrono::steady_clock::now();
+		{
+			BatchingLogger batching_logger;
+			if (mode == 0) {
+				time_log_calls(thread_count, records_per_thread, [&batching_logger](const std::string&, int value) {
+					batching_logger.log_data(ThreadRegistry::current(), value);
+				});
+			} else if (mode == 1) {
+				// Each call writes one batch of 64 records
+				time_log_calls(thread_count, records_per_thread / 64, [&batching_logger](const std::string&, int value) {
+					LogBatch batch(batching_logger);
+					for (int i = 0; i < 64; ++i) {
+						batch.add(ThreadRegistry::current(), value * 64 + i);
+					}
+				});
+			} else {
+				time_log_calls(thread_count, records_per_thread, [&batching_logger](const std::string&, int value) {
+					batching_logger.log_batched(ThreadRegistry::current(), value);
+				});
+			}
+			acquisitions = batching_logger.lock_acquisitions();
+		}
+		const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		const char* names[] = {"log_data:    ", "LogBatch(64):", "log_batched: "};
+		std::cout << names[mode] << " " << static_cast<double>(acquisitions) / records << " lock acquisitions/record, "
+			<< elapsed.count() * 1e9 / records << " ns/record" << std::endl;
+	}
+	return 0;
+}
+
+/*
+ * Lazy initialization with a lock-free fast path
+ */
+
+// OnceLogger from thread_synchronization_example.cpp, with the file_mutex it
+// declares actually taken so that concurrent writes are not a data race
+class CallOnceLogger {
+	// Mutex to protect the log file
+	std::mutex file_mutex;
+	// Log file stream
+	std::ofstream log_file;
+	// Flag to indicate if initialization has occurred
+	std::once_flag init_flag;
+
+	// Initialization function
+	void initialize() {
+		log_file.open("once_log.txt");
+	}
+
+public:
+	// Function to log data with thread-safe initialization
+	void log_data(ThreadHandle thread_id, int value) {
+		std::call_once(init_flag, &CallOnceLogger::initialize, this);
+		std::lock_guard<std::mutex> lock(file_mutex);
+		log_file << "From " << ThreadRegistry::name(thread_id) << ": " << value << std::endl;
+	}
+};
+
+class FastOnceLogger {
+	// Sink published once by the first caller
+	struct Sink {
+		// File opened in append mode, each write() lands as one unit
+		int fd = -1;
+		// Mutex taken only when a thread logs for the first time
+		std::mutex buffers_mutex;
+		// One buffer per thread that has logged through this sink
+		std::vector<std::unique_ptr<std::string>> buffers;
+	};
+
+	// Buffers are written out once they hold this many bytes
+	static constexpr std::size_t flush_bytes = 4096;
+
+	// Null until initialization has completed
+	std::atomic<Sink*> sink{nullptr};
+	// Mutex taken only by callers that race on the first record
+	std::mutex init_mutex;
+	// Owner of the published sink
+	std::unique_ptr<Sink> sink_storage;
+	// The calling thread's buffer, looked up without a lock
+	ThreadSlots<std::string> buffer_slots;
+
+	// Slow path: create the sink and publish it with a release store
+	Sink& initialize() {
+		std::lock_guard<std::mutex> lock(init_mutex);
+		if (Sink* current = sink.load(std::memory_order_relaxed)) {
+			return *current;
+		}
+		sink_storage = std::make_unique<Sink>();
+		sink_storage->fd = ::open("once_log.txt", O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+		if (sink_storage->fd < 0) {
+			throw std::system_error(errno, std::generic_category(), "open once_log.txt");
+		}
+		sink.store(sink_storage.get(), std::memory_order_release);
+		return *sink_storage;
+	}
+
+	// Return the calling thread's buffer, registering one on first use
+	std::string& local_buffer(Sink& current) {
+		return buffer_slots.local([&current]() {
+			std::lock_guard<std::mutex> lock(current.buffers_mutex);
+			current.buffers.push_back(std::make_unique<std::string>());
+			current.buffers.back()->reserve(flush_bytes + 128);
+			return current.buffers.back().get();
+		});
+	}
+
+	// Write a buffer with one append-mode write, which other writers cannot split.
+	// A short write is an error: appending the rest separately could put another
+	// thread's records in the middle of a line. On error the unwritten tail
+	// stays in the buffer and the error is thrown.
+	static void flush(int fd, std::string& buffer) {
+		ssize_t written;
+		do {
+			written = ::write(fd, buffer.data(), buffer.size());
+		} while (written < 0 && errno == EINTR);
+		if (written < 0) {
+			throw std::system_error(errno, std::generic_category(), "write once_log.txt");
+		}
+		const auto done = static_cast<std::size_t>(written);
+		if (done < buffer.size()) {
+			buffer.erase(0, done);
+			throw std::system_error(EIO, std::generic_category(), "short write to once_log.txt");
+		}
+		buffer.clear();
+	}
+
+public:
+	// Constructor, the file is opened lazily by the first record
+	FastOnceLogger() = default;
+
+	// Destructor that writes the remaining buffers and closes the file, records
+	// that cannot be written any more are counted on stderr. Every logging
+	// thread must have finished before the logger is destroyed.
+	~FastOnceLogger() {
+		if (Sink* current = sink.load(std::memory_order_acquire)) {
+			for (const auto& buffer : current->buffers) {
+				try {
+					flush(current->fd, *buffer);
+				} catch (const std::system_error& error) {
+					const auto lost = std::count(buffer->begin(), buffer->end(), '\n');
+					std::cerr << "FastOnceLogger: dropped " << lost << " records, " << error.what() << std::endl;
+				}
+			}
+			::close(current->fd);
+		}
+	}
+
+	// Function to log data: one acquire load replaces call_once, and the
+	// record goes to a per-thread buffer instead of a shared stream. Throws
+	// std::system_error if writing a full buffer fails.
+	void log_data(ThreadHandle thread_id, int value) {
+		Sink* current = sink.load(std::memory_order_acquire);
+		if (current == nullptr) {
+			current = &initialize();
+		}
+		std::string& buffer = local_buffer(*current);
+		char line[128];
+		buffer.append(line, format_record_line(line, thread_id, value));
+		if (buffer.size() >= flush_bytes) {
+			flush(current->fd, buffer);
+		}
+	}
+};
+
+int main() {
+	FastOnceLogger once_logger;
+
+	// Create a thread that logs through the lazily initialized logger
+	std::thread thread1([&once_logger]() {
+		ThreadRegistry::set_current("Thread 1");
+		for (int i = -1; i >= -100; --i) {
+			once_logger.log_data(ThreadRegistry::current(), i);
+		}
+	});
+
+	// Main thread loop
+	ThreadRegistry::set_current("Main Thread");
+	for (int i = 0; i < 100; ++i) {
+		once_logger.log_data(ThreadRegistry::current(), i);
+	}
+
+	// Wait for the thread to finish
+	thread1.join();
+	return 0;
+}
+
+int main() {
+	// Microbenchmark: ns/call for call_once + mutex against the lock-free fast path
+	const int records_per_thread = 20000;
+	for (const int thread_count : {1, 8, 32}) {
+		const double records = static_cast<double>(thread_count) * records_per_thread;
+		double call_once_seconds = 0;
+		{
+			CallOnceLogger call_once_logger;
+			call_once_seconds = time_log_calls(thread_count, records_per_thread,
+				[&call_once_logger](const std::string&, int value) {
+					call_once_logger.log_data(ThreadRegistry::current(), value);
+				});
+		}
+		double fast_seconds = 0;
+		{
+			FastOnceLogger fast_logger;
+			fast_seconds = time_log_calls(thread_count, records_per_thread,
+				[&fast_logger](const std::string&, int value) {
+					fast_logger.log_data(ThreadRegistry::current(), value);
+				});
+		}
+		std::cout << thread_count << " threads: call_once " << call_once_seconds * 1e9 / records
+			<< " ns/call, acquire load " << fast_seconds * 1e9 / records << " ns/call" << std::endl;
+	}
+	return 0;
+}
+
+/*
+ * Compile-time format strings: logger.log<"From {}: {}">(id, value)
+ */
+
+// String literal usable as a template argument. "{}" marks a placeholder,
+// everything else is copied verbatim.
+template <std::size_t N>
+struct FormatString {
+	char text[N];
+
+	constexpr FormatString(const char (&literal)[N]) {
+		std::copy_n(literal, N, text);
+	}
+
+	// Number of "{}" placeholders
+	constexpr std::size_t placeholders() const {
+		std::size_t count = 0;
+		for (std::size_t i = 0; i + 2 < N; ++i) {
+			if (text[i] == '{' && text[i + 1] == '}') {
+				++count;
+				++i;
+			}
+		}
+		return count;
+	}
+};
+
+// Literal segments around the placeholders, computed once per format at compile time
+template <FormatString Format>
+struct FormatSpec {
+	// Number of arguments the format expects
+	static constexpr std::size_t arg_count = Format.placeholders();
+
+	struct Segment {
+		std::size_t offset;
+		std::size_t length;
+	};
+
+	// segments[i] is the literal text before argument i, the last one trails the format
+	static constexpr std::array<Segment, arg_count + 1> segments = []() {
+		std::array<Segment, arg_count + 1> result{};
+		const std::size_t length = sizeof(Format.text) - 1;
+		std::size_t start = 0;
+		std::size_t index = 0;
+		for (std::size_t i = 0; i + 1 < length; ++i) {
+			if (Format.text[i] == '{' && Format.text[i + 1] == '}') {
+				result[index++] = Segment{start, i - start};
+				start = i + 2;
+				++i;
+			}
+		}
+		result[index] = Segment{start, length - start};
+		return result;
+	}();
+
+	// Total literal bytes, known at compile time
+	static constexpr std::size_t literal_bytes = sizeof(Format.text) - 1 - 2 * arg_count;
+};
+
+// Upper bound on the formatted size of each supported argument type
+template <std::integral T>
+	requires(!std::same_as<T, bool>)
+constexpr std::size_t max_formatted_size(T) {
+	return std::numeric_limits<T>::digits10 + 3;
+}
+
+// Exactly bool, so pointers such as string literals still pick string_view
+template <std::same_as<bool> T>
+constexpr std::size_t max_formatted_size(T) {
+	return 5;
+}
+
+inline std::size_t max_formatted_size(std::string_view text) {
+	return text.size();
+}
+
+inline std::size_t max_formatted_size(ThreadHandle thread_id) {
+	return ThreadRegistry::name(thread_id).size();
+}
+
+// Serialize one argument at out and return the new end
+template <std::integral T>
+	requires(!std::same_as<T, bool>)
+char* append_formatted(char* out, T value) {
+	return std::to_chars(out, out + max_formatted_size(value), value).ptr;
+}
+
+inline char* append_formatted(char* out, std::string_view text) {
+	std::memcpy(out, text.data(), text.size());
+	return out + text.size();
+}
+
+inline char* append_formatted(char* out, ThreadHandle thread_id) {
+	return append_formatted(out, ThreadRegistry::name(thread_id));
+}
+
+// std::to_chars has no bool overload; write the word instead of 0/1
+template <std::same_as<bool> T>
+char* append_formatted(char* out, T value) {
+	return append_formatted(out, value ? std::string_view("true") : std::string_view("false"));
+}
+
+// Specialized serializer for one format: the literal segments are memcpy'd
+// with compile-time offsets and lengths, integers go through std::to_chars.
+// out must have room for formatted_size_bound<Format>(args...) bytes.
+template <FormatString Format, typename... Args>
+std::size_t format_to(char* out, const Args&... args) {
+	using Spec = FormatSpec<Format>;
+	static_assert(sizeof...(Args) == Spec::arg_count, "argument count does not match the format string");
+	char* cursor = out;
+	std::size_t segment = 0;
+	const auto copy_literal = [&cursor, &segment]() {
+		std::memcpy(cursor, Format.text + Spec::segments[segment].offset, Spec::segments[segment].length);
+		cursor += Spec::segments[segment].length;
+		++segment;
+	};
+	copy_literal();
+	((cursor = append_formatted(cursor, args), copy_literal()), ...);
+	return static_cast<std::size_t>(cursor - out);
+}
+
+// Upper bound on the bytes format_to<Format> writes for these arguments
+template <FormatString Format, typename... Args>
+std::size_t formatted_size_bound(const Args&... args) {
+	return FormatSpec<Format>::literal_bytes + (std::size_t{0} + ... + max_formatted_size(args));
+}
+
+class FormatLogger {
+	// Pending bytes are written out once they reach this size
+	static constexpr std::size_t flush_bytes = 64 * 1024;
+
+	// File descriptor of the log file
+	int fd = -1;
+	// Mutex to protect the pending buffer
+	std::mutex file_mutex;
+	// Formatted records not yet written
+	std::string pending;
+	// File offset of the next write
+	std::uint64_t file_offset = 0;
+
+	// Write the pending bytes, called with the lock held
+	void flush_pending() {
+		write_all_at(fd, pending.data(), pending.size(), file_offset);
+		file_offset += pending.size();
+		pending.clear();
+	}
+
+public:
+	// Constructor that opens the log file
+	FormatLogger(const std::string& path = "format_log.txt") {
+		fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0) {
+			throw std::system_error(errno, std::generic_category(), "open " + path);
+		}
+		pending.reserve(flush_bytes + 4096);
+	}
+
+	// Prevent copying, the logger owns its file
+	FormatLogger(const FormatLogger&) = delete;
+	FormatLogger& operator=(const FormatLogger&) = delete;
+
+	// Destructor that writes the remaining records and closes the file,
+	// bytes that cannot be written any more are reported on stderr
+	~FormatLogger() {
+		std::lock_guard<std::mutex> lock(file_mutex);
+		try {
+			flush_pending();
+		} catch (const std::system_error& error) {
+			std::cerr << "FormatLogger: dropped " << pending.size() << " bytes, " << error.what() << std::endl;
+		}
+		::close(fd);
+	}
+
+	// Function to log one record: formats into a pre-reserved thread-local
+	// buffer, then copies the finished line under the lock
+	template <FormatString Format, typename... Args>
+	void log(const Args&... args) {
+		thread_local std::string line;
+		const std::size_t bound = formatted_size_bound<Format>(args...) + 1;
+		// Only grows the first time a longer record is seen
+		if (line.size() < bound) {
+			line.resize(bound);
+		}
+		std::size_t length = format_to<Format>(line.data(), args...);
+		line[length++] = '\n';
+		std::lock_guard<std::mutex> lock(file_mutex);
+		pending.append(line.data(), length);
+		if (pending.size() >= flush_bytes) {
+			flush_pending();
+		}
+	}
+};
+
+int main() {
+	FormatLogger format_logger;
+
+	// Create a thread that logs with a compile-time format string
+	std::thread thread1([&format_logger]() {
+		ThreadRegistry::set_current("Thread 1");
+		for (int i = -1; i >= -100; --i) {
+			format_logger.log<"From {}: {}">(ThreadRegistry::current(), i);
+		}
+	});
+
+	// Main thread loop
+	ThreadRegistry::set_current("Main Thread");
+	for (int i = 0; i < 100; ++i) {
+		format_logger.log<"From {}: {}">(ThreadRegistry::current(), i);
+	}
+
+	// Wait for the thread to finish
+	thread1.join();
+	return 0;
+}
+
+int main() {
+	// Formatting cost only: iostream operators against the specialized serializer
+	const int records = 1000000;
+	ThreadRegistry::set_current("Main Thread");
+	const ThreadHandle thread_id = ThreadRegistry::current();
+	std::size_t checksum = 0;
+
+	std::ostringstream stream;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < records; ++i) {
+		stream.str(std::string());
+		stream << "From " << ThreadRegistry::name(thread_id) << ": " << i << '\n';
+		checksum += stream.str().size();
+	}
+	const std::chrono::duration<double> iostream_seconds = std::chrono::steady_clock::now() - start;
+
+	char line[128];
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < records; ++i) {
+		checksum += format_to<"From {}: {}\n">(line, thread_id, i);
+	}
+	const std::chrono::duration<double> format_seconds = std::chrono::steady_clock::now() - start;
+
+	std::cout << "iostream: " << iostream_seconds.count() * 1e9 / records << " ns/record, "
+		<< "format_to: " << format_seconds.count() * 1e9 / records << " ns/record"
+		<< " (checksum " << checksum << ")" << std::endl;
+	return 0;
+}
@@ -0,0 +1,1125 @@
+/*
+ *  Lock-Free Queue Examples
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <deque>
+#include <initializer_list>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// Size of a cache line; indices written by different threads are kept this far apart
+constexpr std::size_t cache_line_size = 64;
+
+// Pin the calling thread to one CPU so a benchmark measures core-to-core
+// transfer rather than scheduler migrations. Ignored where unsupported.
+void pin_to_cpu(unsigned cpu) {
+#if defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu % std::max(1u, std::thread::hardware_concurrency()), &set);
+	pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+	(void)cpu;
+#endif
+}
+
+/*
+ * Waiting strategies: busy-spin, spin-then-park hybrid, blocking
+ */
+
+// Tell the CPU we are spinning: frees pipeline resources for a sibling
+// hyperthread and saves power compared to a bare loop
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__)
+	asm volatile("yield");
+#else
+	std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+}
+
+// Never leaves the CPU: lowest wake-up latency, burns a core while waiting
+class BusySpinWait {
+public:
+	// Wait until word no longer equals seen
+	void wait(const std::atomic<std::size_t>& word, std::size_t seen) {
+		while (word.load(std::memory_order_acquire) == seen) {
+			cpu_relax();
+		}
+	}
+
+	// Nobody ever sleeps, so there is nobody to wake
+	void notify(std::atomic<std::size_t>&) {}
+};
+
+// Spins briefly, then yields forever but never parks: keeps throughput when
+// threads outnumber cores, and the waker still never needs a fence or syscall
+class YieldingWait {
+public:
+	// Wait until word no longer equals seen
+	void wait(const std::atomic<std::size_t>& word, std::size_t seen) {
+		for (int i = 0; word.load(std::memory_order_acquire) == seen; ++i) {
+			if (i < 256) {
+				cpu_relax();
+			} else {
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	// Nobody ever sleeps, so there is nobody to wake
+	void notify(std::atomic<std::size_t>&) {}
+};
+
+// Spin SpinCount times with pause instructions, yield YieldCount times,
+// then park on std::atomic::wait (a futex on Linux). The waker skips the
+// wake syscall entirely unless a waiter has announced that it is parking.
+template <int SpinCount, int YieldCount>
+class ParkingWait {
+	// Number of threads parked or about to park on this strategy
+	alignas(cache_line_size) std::atomic<std::uint32_t> sleepers{0};
+
+public:
+	// Wait until word no longer equals seen
+	void wait(std::atomic<std::size_t>& word, std::size_t seen) {
+		for (int i = 0; i < SpinCount; ++i) {
+			if (word.load(std::memory_order_acquire) != seen) {
+				return;
+			}
+			cpu_relax();
+		}
+		for (int i = 0; i < YieldCount; ++i) {
+			if (word.load(std::memory_order_acquire) != seen) {
+				return;
+			}
+			std::this_thread::yield();
+		}
+		while (word.load(std::memory_order_acquire) == seen) {
+			sleepers.fetch_add(1, std::memory_order_relaxed);
+			// Either the waker sees sleepers != 0 or we see its new word value
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			word.wait(seen, std::memory_order_acquire);
+			sleepers.fetch_sub(1, std::memory_order_relaxed);
+		}
+	}
+
+	// Called after word has changed: wakes sleepers only if there are any
+	void notify(std::atomic<std::size_t>& word) {
+		// Pairs with the fence in wait()
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (sleepers.load(std::memory_order_relaxed) != 0) {
+			word.notify_all();
+		}
+	}
+};
+
+// Spin, then yield, then park: a balance of latency and CPU use
+using HybridWait = ParkingWait<256, 16>;
+// Park straight away: no CPU spent waiting, highest wake-up latency
+using BlockingWait = ParkingWait<0, 0>;
+
+/*
+ * Bounded lock-free SPSC ring buffer
+ */
+
+// Bounded single-producer/single-consumer queue. Head and tail live on
+// separate cache lines, and each side caches the other side's index so the
+// shared line is only read when the queue looks full (or empty).
+// WaitStrategy decides how push() and pop() wait on a full or empty queue.
+// The producer ends the stream with close(); the consumer drains what was
+// pushed before it and then sees end of stream, so no sentinel value is needed.
+template <typename T, std::size_t Capacity, typename WaitStrategy = HybridWait>
+class SpscQueue {
+	static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+	static constexpr std::size_t mask = Capacity - 1;
+	// Set in head once the producer has closed the queue. Closing changes
+	// head, so a consumer parked on it wakes up like it does for new data.
+	static constexpr std::size_t closed_bit = std::size_t{1} << (sizeof(std::size_t) * 8 - 1);
+
+	// Producer side: next slot to write (plus the closed bit) and the last read index it saw
+	alignas(cache_line_size) std::atomic<std::size_t> head{0};
+	std::size_t cached_tail = 0;
+	// Consumer side: next slot to read and the last write index it saw
+	alignas(cache_line_size) std::atomic<std::size_t> tail{0};
+	std::size_t cached_head = 0;
+	// Waiters for the queue becoming non-empty (consumer) and non-full (producer)
+	WaitStrategy not_empty;
+	WaitStrategy not_full;
+	// Slot storage
+	alignas(cache_line_size) T slots[Capacity];
+
+public:
+	// Called only by the producer, returns false when the queue is full or closed
+	template <typename U>
+	bool try_push(U&& value) {
+		const std::size_t current = head.load(std::memory_order_relaxed);
+		if (current & closed_bit) {
+			return false;
+		}
+		if (current - cached_tail == Capacity) {
+			// Looks full: refresh the consumer's index
+			cached_tail = tail.load(std::memory_order_acquire);
+			if (current - cached_tail == Capacity) {
+				return false;
+			}
+		}
+		slots[current & mask] = std::forward<U>(value);
+		// Publish the slot to the consumer
+		head.store(current + 1, std::memory_order_release);
+		not_empty.notify(head);
+		return true;
+	}
+
+	// Called only by the consumer, returns false when the queue is empty
+	bool try_pop(T& value) {
+		const std::size_t current = tail.load(std::memory_order_relaxed);
+		if (current == cached_head) {
+			// Looks empty: refresh the producer's index
+			cached_head = head.load(std::memory_order_acquire) & ~closed_bit;
+			if (current == cached_head) {
+				return false;
+			}
+		}
+		value = std::move(slots[current & mask]);
+		// Hand the slot back to the producer
+		tail.store(current + 1, std::memory_order_release);
+		not_full.notify(tail);
+		return true;
+	}
+
+	// Push, waiting while the queue is full. Returns false if the queue is closed.
+	template <typename U>
+	bool push(U&& value) {
+		while (!try_push(std::forward<U>(value))) {
+			if (is_closed()) {
+				return false;
+			}
+			// Full means tail is exactly one lap behind head
+			not_full.wait(tail, head.load(std::memory_order_relaxed) - Capacity);
+		}
+		return true;
+	}
+
+	// Pop, waiting while the queue is empty. Returns false once the queue is
+	// closed and every item pushed before close() has been popped.
+	bool pop(T& value) {
+		while (!try_pop(value)) {
+			if (is_drained()) {
+				return false;
+			}
+			// Empty means head equals our tail; close() changes head too
+			not_empty.wait(head, tail.load(std::memory_order_relaxed));
+		}
+		return true;
+	}
+
+	// Called only by the producer: copy as many values as fit and publish
+	// them with a single release store, returns how many were pushed (0 once closed)
+	std::size_t try_push_bulk(std::span<const T> values) {
+		const std::size_t current = head.load(std::memory_order_relaxed);
+		if (current & closed_bit) {
+			return 0;
+		}
+		if (Capacity - (current - cached_tail) < values.size()) {
+			cached_tail = tail.load(std::memory_order_acquire);
+		}
+		const std::size_t count = std::min(values.size(), Capacity - (current - cached_tail));
+		for (std::size_t i = 0; i < count; ++i) {
+			slots[(current + i) & mask] = values[i];
+		}
+		if (count > 0) {
+			head.store(current + count, std::memory_order_release);
+			not_empty.notify(head);
+		}
+		return count;
+	}
+
+	// Called only by the consumer: move up to max values to out and release
+	// their slots with a single store, returns how many were popped
+	std::size_t try_pop_bulk(T* out, std::size_t max) {
+		const std::size_t current = tail.load(std::memory_order_relaxed);
+		if (cached_head - current < max) {
+			cached_head = head.load(std::memory_order_acquire) & ~closed_bit;
+		}
+		const std::size_t count = std::min(max, cached_head - current);
+		for (std::size_t i = 0; i < count; ++i) {
+			out[i] = std::move(slots[(current + i) & mask]);
+		}
+		if (count > 0) {
+			tail.store(current + count, std::memory_order_release);
+			not_full.notify(tail);
+		}
+		return count;
+	}
+
+	// Push every value, waiting only while the queue is completely full.
+	// Returns false, with the rest unpushed, if the queue is closed.
+	bool push_bulk(std::span<const T> values) {
+		while (!values.empty()) {
+			const std::size_t pushed = try_push_bulk(values);
+			if (pushed == 0) {
+				if (is_closed()) {
+					return false;
+				}
+				not_full.wait(tail, head.load(std::memory_order_relaxed) - Capacity);
+			}
+			values = values.subspan(pushed);
+		}
+		return true;
+	}
+
+	// Wait for at least one value, then drain everything available up to max.
+	// Returns 0 once the queue is closed and drained.
+	std::size_t pop_bulk(T* out, std::size_t max) {
+		std::size_t count;
+		while ((count = try_pop_bulk(out, max)) == 0) {
+			if (is_drained()) {
+				return 0;
+			}
+			not_empty.wait(head, tail.load(std::memory_order_relaxed));
+		}
+		return count;
+	}
+
+	// Called only by the producer: end the stream. Items already pushed can
+	// still be popped; setting the bit in head wakes a parked consumer.
+	void close() {
+		head.store(head.load(std::memory_order_relaxed) | closed_bit, std::memory_order_release);
+		not_empty.notify(head);
+	}
+
+	bool is_closed() const {
+		return (head.load(std::memory_order_acquire) & closed_bit) != 0;
+	}
+
+	// Called only by the consumer: true once closed and every item has been popped
+	bool is_drained() const {
+		const std::size_t end = head.load(std::memory_order_acquire);
+		return (end & closed_bit) != 0 && tail.load(std::memory_order_relaxed) == (end & ~closed_bit);
+	}
+};
+
+// Global ring replacing dataQueue, dataMutex and dataCondVar. The consumer
+// spends most of its time parked, so the default hybrid strategy fits.
+SpscQueue<int, 1024> dataRing;
+
+// Function to produce data
+void producer() {
+	// Producer will run and produce data 10 times
+	int count = 10;
+	while (count > 0) {
+		// No lock, and a wake-up only if the consumer has parked
+		dataRing.push(count);
+		// Pause for 1 second before producing the next data
+		std::this_thread::sleep_for(std::chrono::seconds(1));
+		count--;
+	}
+	// End of stream: the consumer stops once it has drained the ring
+	dataRing.close();
+}
+
+// Function to consume data
+void consumer() {
+	int data = 0;
+	// Wait for each item until the producer closes the ring
+	while (dataRing.pop(data)) {
+		// Print the data
+		std::cout << "Consumer received data: " << data << std::endl;
+	}
+}
+
+int main() {
+	// Create a producer thread and a consumer thread
+	std::thread producerThread(producer);
+	std::thread consumerThread(consumer);
+	// Wait for both threads to finish
+	producerThread.join();
+	consumerThread.join();
+	return 0;
+}
+
+/*
+ * Benchmark: SPSC ring against the mutex + deque + condition variable version
+ */
+
+// Move count items through the demo's deque/mutex/condvar protocol, returns items/sec
+double benchmark_deque(int count) {
+	std::deque<int> queue;
+	std::mutex mutex;
+	std::condition_variable condVar;
+	const auto start = std::chrono::steady_clock::now();
+	std::thread producerThread([&]() {
+		pin_to_cpu(0);
+		for (int i = 1; i <= count; ++i) {
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				queue.push_front(i);
+			}
+			condVar.notify_one();
+		}
+	});
+	std::thread consumerThread([&]() {
+		pin_to_cpu(1);
+		for (int received = 0; received < count; ++received) {
+			std::unique_lock<std::mutex> lock(mutex);
+			condVar.wait(lock, [&queue]() { return !queue.empty(); });
+			queue.pop_back();
+		}
+	});
+	producerThread.join();
+	consumerThread.join();
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	return count / elapsed.count();
+}
+
+// Move count items through an SPSC ring, returns items/sec
+double benchmark_spsc(int count) {
+	// Large rings do not fit on a thread stack. A non-parking strategy avoids
+	// the fence that parking strategies need on every push.
+	auto ring = std::make_unique<SpscQueue<int, 65536, YieldingWait>>();
+	long long sum = 0;
+	const auto start = std::chrono::steady_clock::now();
+	std::thread producerThread([&ring, count]() {
+		pin_to_cpu(0);
+		for (int i = 1; i <= count; ++i) {
+			ring->push(i);
+		}
+	});
+	std::thread consumerThread([&ring, &sum, count]() {
+		pin_to_cpu(1);
+		int value = 0;
+		for (int received = 0; received < count; ++received) {
+			ring->pop(value);
+			sum += value;
+		}
+	});
+	producerThread.join();
+	consumerThread.join();
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	if (sum != static_cast<long long>(count) * (count + 1) / 2) {
+		std::cerr << "SPSC ring lost or duplicated items" << std::endl;
+	}
+	return count / elapsed.count();
+}
+
+int main() {
+	const int count = 20000000;
+	std::cout << "mutex + deque: " << benchmark_deque(count) / 1e6 << " M items/sec" << std::endl;
+	std::cout << "SPSC ring:     " << benchmark_spsc(count) / 1e6 << " M items/sec" << std::endl;
+	return 0;
+}
+
+/*
+ * Bounded MPMC queue with per-slot sequence numbers (Vyukov)
+ */
+
+// Bounded multi-producer/multi-consumer queue. Every cell carries a sequence
+// number telling whether it is ready to be written or read for a given lap,
+// so producers and consumers only contend on their own position counter.
+// WaitStrategy decides how push() and pop() wait on a full or empty queue:
+// consumers wait on the enqueue position and producers on the dequeue position.
+template <typename T, typename WaitStrategy = HybridWait>
+class MpmcQueue {
+	struct alignas(cache_line_size) Cell {
+		// Equals the position for a writable cell, position + 1 for a readable one
+		std::atomic<std::size_t> sequence;
+		T value;
+	};
+
+	// Cell storage, the capacity is a power of two
+	std::unique_ptr<Cell[]> cells;
+	const std::size_t mask;
+	// Set in both positions once the queue is closed. Closing changes the
+	// word every waiter waits on, so parked producers and consumers wake up.
+	static constexpr std::size_t closed_bit = std::size_t{1} << (sizeof(std::size_t) * 8 - 1);
+
+	// Next position to write, shared by every producer, plus the closed bit
+	alignas(cache_line_size) std::atomic<std::size_t> enqueue_position{0};
+	// Next position to read, shared by every consumer, plus the closed bit
+	alignas(cache_line_size) std::atomic<std::size_t> dequeue_position{0};
+	// Waiters for the queue becoming non-empty (consumers) and non-full (producers)
+	WaitStrategy not_empty;
+	WaitStrategy not_full;
+
+public:
+	// Constructor that allocates capacity cells, capacity must be a power of two
+	explicit MpmcQueue(std::size_t capacity) : cells(new Cell[capacity]), mask(capacity - 1) {
+		if (capacity < 2 || (capacity & (capacity - 1)) != 0) {
+			throw std::invalid_argument("MpmcQueue capacity must be a power of two");
+		}
+		for (std::size_t i = 0; i < capacity; ++i) {
+			cells[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	// Returns false when the queue is full or closed
+	template <typename U>
+	bool try_push(U&& value) {
+		std::size_t position = enqueue_position.load(std::memory_order_relaxed);
+		Cell* cell;
+		while (true) {
+			// Closing sets the bit, so a claim can never succeed after close()
+			if (position & closed_bit) {
+				return false;
+			}
+			cell = &cells[position & mask];
+			const std::size_t sequence = cell->sequence.load(std::memory_order_acquire);
+			const auto difference = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(position);
+			if (difference == 0) {
+				// The cell is free for this lap: claim the position
+				if (enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+					break;
+				}
+			} else if (difference < 0) {
+				// The cell still holds last lap's value: the queue is full
+				return false;
+			} else {
+				// Another producer claimed this position, retry with the current one
+				position = enqueue_position.load(std::memory_order_relaxed);
+			}
+		}
+		cell->value = std::forward<U>(value);
+		// Mark the cell readable for consumers of this lap
+		cell->sequence.store(position + 1, std::memory_order_release);
+		not_empty.notify(enqueue_position);
+		return true;
+	}
+
+	// Returns false when the queue is empty
+	bool try_pop(T& value) {
+		std::size_t position = dequeue_position.load(std::memory_order_relaxed);
+		Cell* cell;
+		std::size_t index;
+		while (true) {
+			// The closed bit rides along in the CAS but is not part of the index
+			index = position & ~closed_bit;
+			cell = &cells[index & mask];
+			const std::size_t sequence = cell->sequence.load(std::memory_order_acquire);
+			const auto difference = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(index + 1);
+			if (difference == 0) {
+				// The cell holds a value for this lap: claim the position
+				if (dequeue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+					break;
+				}
+			} else if (difference < 0) {
+				// Nothing written at this position yet: the queue is empty
+				return false;
+			} else {
+				// Another consumer claimed this position, retry with the current one
+				position = dequeue_position.load(std::memory_order_relaxed);
+			}
+		}
+		value = std::move(cell->value);
+		// Make the cell writable again for the next lap
+		cell->sequence.store(index + mask + 1, std::memory_order_release);
+		not_full.notify(dequeue_position);
+		return true;
+	}
+
+	// Push, waiting while the queue is full. Returns false, without
+	// consuming value, if the queue is closed.
+	template <typename U>
+	bool push(U&& value) {
+		while (true) {
+			const std::size_t start = dequeue_position.load(std::memory_order_acquire);
+			if (try_push(std::forward<U>(value))) {
+				return true;
+			}
+			if (is_closed()) {
+				return false;
+			}
+			// Fewer than capacity items claimed: a pop is still releasing its cell
+			const std::size_t end = enqueue_position.load(std::memory_order_acquire) & ~closed_bit;
+			if (end - (start & ~closed_bit) <= mask) {
+				std::this_thread::yield();
+				continue;
+			}
+			not_full.wait(dequeue_position, start);
+		}
+	}
+
+	// Pop, waiting while the queue is empty. Returns false once the queue is
+	// closed and every item pushed before close() has been popped.
+	bool pop(T& value) {
+		while (true) {
+			const std::size_t end = enqueue_position.load(std::memory_order_acquire);
+			if (try_pop(value)) {
+				return true;
+			}
+			if (is_drained()) {
+				return false;
+			}
+			// A position is claimed but not yet published: its push is still writing
+			if ((dequeue_position.load(std::memory_order_acquire) & ~closed_bit) < (end & ~closed_bit)) {
+				std::this_thread::yield();
+				continue;
+			}
+			not_empty.wait(enqueue_position, end);
+		}
+	}
+
+	// Refuse further pushes and wake every waiting thread; items already
+	// pushed can still be popped
+	void close() {
+		enqueue_position.fetch_or(closed_bit, std::memory_order_acq_rel);
+		dequeue_position.fetch_or(closed_bit, std::memory_order_acq_rel);
+		not_full.notify(dequeue_position);
+		not_empty.notify(enqueue_position);
+	}
+
+	bool is_closed() const {
+		return (enqueue_position.load(std::memory_order_acquire) & closed_bit) != 0;
+	}
+
+	// True once closed and every claimed position has been consumed. A
+	// position claimed before close() but not yet published keeps this false.
+	bool is_drained() const {
+		const std::size_t end = enqueue_position.load(std::memory_order_acquire);
+		return (end & closed_bit) != 0
+			&& (dequeue_position.load(std::memory_order_acquire) & ~closed_bit) >= (end & ~closed_bit);
+	}
+};
+
+/*
+ * Benchmark: producers x consumers scaling against the mutex + deque baseline
+ */
+
+// The demo's deque/mutex/condvar protocol wrapped with the same interface
+template <typename T>
+class LockedDeque {
+	// Queue, mutex and condition variable exactly as in the demo
+	std::deque<T> queue;
+	std::mutex mutex;
+	std::condition_variable condVar;
+	// Set by close(), protected by the mutex
+	bool closed = false;
+
+public:
+	// Push under the lock, then wake one consumer. Returns false if the queue is closed.
+	bool push(T value) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			if (closed) {
+				return false;
+			}
+			queue.push_front(std::move(value));
+		}
+		condVar.notify_one();
+		return true;
+	}
+
+	// Wait until the queue is not empty, then pop from the back. Returns
+	// false once the queue is closed and drained.
+	bool pop(T& value) {
+		std::unique_lock<std::mutex> lock(mutex);
+		condVar.wait(lock, [this]() { return !queue.empty() || closed; });
+		if (queue.empty()) {
+			return false;
+		}
+		value = std::move(queue.back());
+		queue.pop_back();
+		return true;
+	}
+
+	// Push every value under one lock acquisition and one notification.
+	// Returns false, pushing nothing, if the queue is closed.
+	bool push_bulk(std::span<const T> values) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			if (closed) {
+				return false;
+			}
+			for (const T& value : values) {
+				queue.push_front(value);
+			}
+		}
+		// A pop_bulk() consumer drains the whole batch, but pop() consumers take one item each
+		if (values.size() == 1) {
+			condVar.notify_one();
+		} else {
+			condVar.notify_all();
+		}
+		return true;
+	}
+
+	// Wait for at least one value, then drain up to max under the same lock.
+	// Returns 0 once the queue is closed and drained.
+	std::size_t pop_bulk(T* out, std::size_t max) {
+		std::unique_lock<std::mutex> lock(mutex);
+		condVar.wait(lock, [this]() { return !queue.empty() || closed; });
+		const std::size_t count = std::min(max, queue.size());
+		for (std::size_t i = 0; i < count; ++i) {
+			out[i] = std::move(queue.back());
+			queue.pop_back();
+		}
+		return count;
+	}
+
+	// Refuse further pushes and wake every blocked consumer
+	void close() {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			closed = true;
+		}
+		condVar.notify_all();
+	}
+};
+
+// Move count items from producers to consumers, returns items/sec. The
+// queue is closed once every producer has finished; consumers then drain and stop.
+template <typename Queue>
+double benchmark_queue(Queue& queue, int producers, int consumers, int count) {
+	const auto start = std::chrono::steady_clock::now();
+	std::vector<std::thread> producerThreads;
+	std::vector<std::thread> consumerThreads;
+	for (int c = 0; c < consumers; ++c) {
+		consumerThreads.emplace_back([&queue]() {
+			int value = 0;
+			while (queue.pop(value)) {
+			}
+		});
+	}
+	for (int p = 0; p < producers; ++p) {
+		producerThreads.emplace_back([&queue, p, producers, count]() {
+			for (int i = p; i < count; i += producers) {
+				queue.push(i);
+			}
+		});
+	}
+	for (auto& thread : producerThreads) {
+		thread.join();
+	}
+	queue.close();
+	for (auto& thread : consumerThreads) {
+		thread.join();
+	}
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	return count / elapsed.count();
+}
+
+int main() {
+	const int count = 2000000;
+	for (int producers = 1; producers <= 16; producers *= 2) {
+		for (int consumers = 1; consumers <= 16; consumers *= 2) {
+			LockedDeque<int> locked;
+			MpmcQueue<int> mpmc(4096);
+			const double locked_rate = benchmark_queue(locked, producers, consumers, count);
+			const double mpmc_rate = benchmark_queue(mpmc, producers, consumers, count);
+			std::cout << producers << "x" << consumers << ": mutex + deque " << locked_rate / 1e6
+				<< " M items/sec, MPMC " << mpmc_rate / 1e6 << " M items/sec" << std::endl;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Batched push/pop: many items per synchronization event
+ */
+
+// Global queue for the batched producer/consumer pair
+LockedDeque<int> batchQueue;
+
+// Function to produce data in batches of five
+void batchProducer() {
+	int batch[5];
+	for (int round = 0; round < 2; ++round) {
+		for (int i = 0; i < 5; ++i) {
+			batch[i] = 10 - round * 5 - i;
+		}
+		// One lock acquisition and one notification for five items
+		batchQueue.push_bulk(batch);
+		std::this_thread::sleep_for(std::chrono::seconds(1));
+	}
+	// End of stream instead of an in-band sentinel
+	batchQueue.close();
+}
+
+// Function to consume data, draining everything available per wakeup
+// until pop_bulk() reports end of stream
+void batchConsumer() {
+	int data[16];
+	std::size_t count;
+	while ((count = batchQueue.pop_bulk(data, 16)) > 0) {
+		for (std::size_t i = 0; i < count; ++i) {
+			std::cout << "Consumer received data: " << data[i] << std::endl;
+		}
+	}
+}
+
+int main() {
+	std::thread producerThread(batchProducer);
+	std::thread consumerThread(batchConsumer);
+	producerThread.join();
+	consumerThread.join();
+	return 0;
+}
+
+// Move count items in batches of batch_size from one producer to one consumer, returns items/sec
+template <typename Queue>
+double benchmark_bulk(Queue& queue, int count, std::size_t batch_size) {
+	const auto start = std::chrono::steady_clock::now();
+	std::thread producerThread([&queue, count, batch_size]() {
+		std::vector<int> batch(batch_size);
+		for (int i = 0; i < count; i += static_cast<int>(batch_size)) {
+			const std::size_t size = std::min(batch_size, static_cast<std::size_t>(count - i));
+			for (std::size_t j = 0; j < size; ++j) {
+				batch[j] = i + static_cast<int>(j);
+			}
+			queue.push_bulk(std::span<const int>(batch.data(), size));
+		}
+	});
+	std::thread consumerThread([&queue, count, batch_size]() {
+		std::vector<int> out(batch_size);
+		for (int received = 0; received < count;) {
+			received += static_cast<int>(queue.pop_bulk(out.data(), batch_size));
+		}
+	});
+	producerThread.join();
+	consumerThread.join();
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	return count / elapsed.count();
+}
+
+int main() {
+	const int count = 10000000;
+	for (const std::size_t batch_size : {std::size_t{1}, std::size_t{16}, std::size_t{256}}) {
+		LockedDeque<int> locked;
+		auto ring = std::make_unique<SpscQueue<int, 65536, YieldingWait>>();
+		const double locked_rate = benchmark_bulk(locked, count, batch_size);
+		const double ring_rate = benchmark_bulk(*ring, count, batch_size);
+		std::cout << "batch " << batch_size << ": mutex + deque " << locked_rate / 1e6
+			<< " M items/sec, SPSC ring " << ring_rate / 1e6 << " M items/sec" << std::endl;
+	}
+	return 0;
+}
+
+/*
+ * Benchmark: CPU spent waiting against wake-up latency for each strategy
+ */
+
+// CPU time consumed by the calling thread, in seconds
+double thread_cpu_seconds() {
+	timespec now;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+	return static_cast<double>(now.tv_sec) + static_cast<double>(now.tv_nsec) * 1e-9;
+}
+
+// Send timestamped items through ring with a pause between them; report the
+// consumer's mean wake-up latency and the CPU it burned while waiting
+template <typename Queue>
+void benchmark_wait_strategy(const char* name, Queue& ring, int count, std::chrono::microseconds pause) {
+	double consumer_cpu = 0;
+	std::int64_t total_latency = 0;
+	std::thread consumerThread([&ring, &consumer_cpu, &total_latency, count]() {
+		const double cpu_start = thread_cpu_seconds();
+		std::int64_t sent = 0;
+		for (int i = 0; i < count; ++i) {
+			ring.pop(sent);
+			total_latency += std::chrono::steady_clock::now().time_since_epoch().count() - sent;
+		}
+		consumer_cpu = thread_cpu_seconds() - cpu_start;
+	});
+	for (int i = 0; i < count; ++i) {
+		std::this_thread::sleep_for(pause);
+		ring.push(static_cast<std::int64_t>(std::chrono::steady_clock::now().time_since_epoch().count()));
+	}
+	consumerThread.join();
+	std::cout << name << ": mean wake-up latency "
+		<< std::chrono::duration<double, std::micro>(std::chrono::steady_clock::duration(total_latency / count)).count()
+		<< " us, consumer CPU " << consumer_cpu << " s" << std::endl;
+}
+
+int main() {
+	const int count = 2000;
+	const std::chrono::microseconds pause(500);
+	benchmark_wait_strategy("SPSC busy-spin", *std::make_unique<SpscQueue<std::int64_t, 1024, BusySpinWait>>(), count, pause);
+	benchmark_wait_strategy("SPSC yielding ", *std::make_unique<SpscQueue<std::int64_t, 1024, YieldingWait>>(), count, pause);
+	benchmark_wait_strategy("SPSC hybrid   ", *std::make_unique<SpscQueue<std::int64_t, 1024, HybridWait>>(), count, pause);
+	benchmark_wait_strategy("SPSC blocking ", *std::make_unique<SpscQueue<std::int64_t, 1024, BlockingWait>>(), count, pause);
+	benchmark_wait_strategy("MPMC busy-spin", *std::make_unique<MpmcQueue<std::int64_t, BusySpinWait>>(1024), count, pause);
+	benchmark_wait_strategy("MPMC yielding ", *std::make_unique<MpmcQueue<std::int64_t, YieldingWait>>(1024), count, pause);
+	benchmark_wait_strategy("MPMC hybrid   ", *std::make_unique<MpmcQueue<std::int64_t, HybridWait>>(1024), count, pause);
+	benchmark_wait_strategy("MPMC blocking ", *std::make_unique<MpmcQueue<std::int64_t, BlockingWait>>(1024), count, pause);
+	return 0;
+}
+
+/*
+ * Graceful close: deterministic pipeline shutdown without sentinels
+ */
+
+int main() {
+	// Stage 1 -> stage 2 -> stage 3, every value is legitimate data (including 1)
+	MpmcQueue<int> rawQueue(256);
+	LockedDeque<int> squaredQueue;
+	std::atomic<long long> total{0};
+
+	// Four producers each send the values 1..1000
+	std::vector<std::thread> producers;
+	for (int p = 0; p < 4; ++p) {
+		producers.emplace_back([&rawQueue]() {
+			for (int i = 1; i <= 1000; ++i) {
+				rawQueue.push(i);
+			}
+		});
+	}
+	// Three workers square values until the raw queue reports end of stream
+	std::vector<std::thread> workers;
+	for (int w = 0; w < 3; ++w) {
+		workers.emplace_back([&rawQueue, &squaredQueue]() {
+			int value = 0;
+			while (rawQueue.pop(value)) {
+				squaredQueue.push(value * value);
+			}
+		});
+	}
+	// Two consumers sum until the squared queue reports end of stream
+	std::vector<std::thread> consumers;
+	for (int c = 0; c < 2; ++c) {
+		consumers.emplace_back([&squaredQueue, &total]() {
+			int value = 0;
+			while (squaredQueue.pop(value)) {
+				total += value;
+			}
+		});
+	}
+
+	// Shut down stage by stage: close a queue once everything feeding it has finished
+	for (auto& thread : producers) {
+		thread.join();
+	}
+	rawQueue.close();
+	for (auto& thread : workers) {
+		thread.join();
+	}
+	squaredQueue.close();
+	for (auto& thread : consumers) {
+		thread.join();
+	}
+
+	std::cout << "Sum of squares: " << total << " (expected " << 4LL * 1000 * 1001 * 2001 / 6 << ")" << std::endl;
+	// Pushes after close fail fast
+	std::cout << "Push after close accepted: " << std::boolalpha << rawQueue.push(42) << std::endl;
+	return 0;
+}
+
+/*
+ * Disruptor-style multicast ring: every consumer sees every item
+ */
+
+// Sequence counter on its own cache line, -1 means nothing yet
+struct alignas(cache_line_size) Sequence {
+	std::atomic<std::int64_t> value{-1};
+};
+
+// Spin, then yield, until value reaches target; returns the value seen
+inline std::int64_t wait_for_sequence(const std::atomic<std::int64_t>& value, std::int64_t target) {
+	std::int64_t seen;
+	for (int i = 0; (seen = value.load(std::memory_order_acquire)) < target; ++i) {
+		if (i < 256) {
+			cpu_relax();
+		} else {
+			std::this_thread::yield();
+		}
+	}
+	return seen;
+}
+
+// Pre-allocated ring for one producer and many independent consumers. Each
+// consumer has its own cursor; the producer never overwrites a slot that a
+// gating (most downstream) consumer has not processed yet.
+template <typename T, std::size_t Capacity>
+class MulticastRing {
+	static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+	static constexpr std::size_t mask = Capacity - 1;
+
+public:
+	class Consumer {
+		friend class MulticastRing;
+		// Ring the consumer reads from
+		MulticastRing& ring;
+		// Last sequence this consumer has processed
+		Sequence processed;
+		// Sequences this consumer may not overtake: the producer cursor or upstream consumers
+		std::vector<const std::atomic<std::int64_t>*> barriers;
+
+		// Lowest sequence every barrier has reached
+		std::int64_t available() const {
+			std::int64_t minimum = INT64_MAX;
+			for (const auto* barrier : barriers) {
+				minimum = std::min(minimum, barrier->load(std::memory_order_acquire));
+			}
+			return minimum;
+		}
+
+	public:
+		Consumer(MulticastRing& owner) : ring(owner) {}
+
+		// Pass every available item to handler(T&, sequence), then advance the
+		// cursor once for the whole batch. Returns how many items were handled.
+		template <typename Handler>
+		std::size_t poll(Handler handler) {
+			const std::int64_t next = processed.value.load(std::memory_order_relaxed) + 1;
+			const std::int64_t last = available();
+			for (std::int64_t sequence = next; sequence <= last; ++sequence) {
+				handler(ring.slots[static_cast<std::size_t>(sequence) & mask], sequence);
+			}
+			if (last >= next) {
+				processed.value.store(last, std::memory_order_release);
+				return static_cast<std::size_t>(last - next + 1);
+			}
+			return 0;
+		}
+
+		// Handle items until sequence last has been processed
+		template <typename Handler>
+		void run_until(std::int64_t last, Handler handler) {
+			while (processed.value.load(std::memory_order_relaxed) < last) {
+				if (poll(handler) == 0) {
+					// Nothing new: wait until the slowest barrier moves
+					for (const auto* barrier : barriers) {
+						wait_for_sequence(*barrier, processed.value.load(std::memory_order_relaxed) + 1);
+					}
+				}
+			}
+		}
+	};
+
+	// Constructor that pre-allocates every slot
+	MulticastRing() : slots(new T[Capacity]()) {}
+
+	// Register a consumer that reads after every consumer in upstream (or
+	// straight after the producer when upstream is empty). All consumers must
+	// be added before the first publish.
+	Consumer& add_consumer(std::initializer_list<Consumer*> upstream = {}) {
+		consumers.push_back(std::make_unique<Consumer>(*this));
+		Consumer& consumer = *consumers.back();
+		if (upstream.size() == 0) {
+			consumer.barriers.push_back(&cursor.value);
+		}
+		for (Consumer* dependency : upstream) {
+			consumer.barriers.push_back(&dependency->processed.value);
+			// Only the most downstream consumers need to gate the producer
+			gating.erase(std::remove(gating.begin(), gating.end(), &dependency->processed.value), gating.end());
+		}
+		gating.push_back(&consumer.processed.value);
+		return consumer;
+	}
+
+	// Producer only: wait for a free slot, let fill write it in place, publish it
+	template <typename Fill>
+	void publish(Fill fill) {
+		const std::int64_t sequence = next_sequence++;
+		// The slot was last used one lap ago; every gating consumer must be past it
+		const std::int64_t wrap_point = sequence - static_cast<std::int64_t>(Capacity);
+		if (wrap_point > cached_gate) {
+			cached_gate = INT64_MAX;
+			for (const auto* gate : gating) {
+				cached_gate = std::min(cached_gate, wait_for_sequence(*gate, wrap_point));
+			}
+		}
+		fill(slots[static_cast<std::size_t>(sequence) & mask]);
+		cursor.value.store(sequence, std::memory_order_release);
+	}
+
+private:
+	// Slot storage, allocated once
+	std::unique_ptr<T[]> slots;
+	// Last published sequence
+	Sequence cursor;
+	// Producer-local: next sequence to claim and the last gate position seen
+	std::int64_t next_sequence = 0;
+	std::int64_t cached_gate = -1;
+	// Registered consumers and the cursors that gate the producer
+	std::vector<std::unique_ptr<Consumer>> consumers;
+	std::vector<const std::atomic<std::int64_t>*> gating;
+};
+
+// Item broadcast to every consumer
+struct Reading {
+	int value;
+	// Filled in by the aggregator stage, read by the forwarder stage
+	long long running_total;
+};
+
+int main() {
+	const std::int64_t count = 10;
+	auto ring = std::make_unique<MulticastRing<Reading, 1024>>();
+	// Logger and aggregator read straight after the producer, the forwarder waits for the aggregator
+	auto& logger = ring->add_consumer();
+	auto& aggregator = ring->add_consumer();
+	auto& forwarder = ring->add_consumer({&aggregator});
+
+	std::thread loggerThread([&logger, count]() {
+		logger.run_until(count - 1, [](Reading& reading, std::int64_t) {
+			std::cout << "Logger received data: " << reading.value << std::endl;
+		});
+	});
+	std::thread aggregatorThread([&aggregator, count]() {
+		long long total = 0;
+		aggregator.run_until(count - 1, [&total](Reading& reading, std::int64_t) {
+			total += reading.value;
+			reading.running_total = total;
+		});
+	});
+	std::thread forwarderThread([&forwarder, count]() {
+		forwarder.run_until(count - 1, [](Reading& reading, std::int64_t sequence) {
+			std::cout << "Forwarder sent total " << reading.running_total << " for item " << sequence << std::endl;
+		});
+	});
+
+	// The producer writes each item in place, nothing is allocated or copied per item
+	for (int i = 10; i > 0; --i) {
+		ring->publish([i](Reading& reading) { reading.value = i; });
+	}
+	loggerThread.join();
+	aggregatorThread.join();
+	forwarderThread.join();
+	return 0;
+}
+
+int main() {
+	// Broadcast throughput: one producer, three consumers, each sees every item
+	const std::int64_t count = 20000000;
+	auto ring = std::make_unique<MulticastRing<std::int64_t, 65536>>();
+	std::vector<MulticastRing<std::int64_t, 65536>::Consumer*> consumers;
+	for (int c = 0; c < 3; ++c) {
+		consumers.push_back(&ring->add_consumer());
+	}
+	std::vector<long long> sums(consumers.size());
+	const auto start = std::chrono::steady_clock::now();
+	std::vector<std::thread> threads;
+	for (std::size_t c = 0; c < consumers.size(); ++c) {
+		threads.emplace_back([&consumers, &sums, c, count]() {
+			consumers[c]->run_until(count - 1, [&sums, c](std::int64_t& value, std::int64_t) { sums[c] += value; });
+		});
+	}
+	for (std::int64_t i = 0; i < count; ++i) {
+		ring->publish([i](std::int64_t& value) { value = i; });
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	std::cout << count / elapsed.count() / 1e6 << " M items/sec delivered to each of " << consumers.size()
+		<< " consumers (sums " << (sums[0] == sums[1] && sums[1] == sums[2] ? "match" : "DIFFER") << ")" << std::endl;
+	return 0;
+}
@@ -0,0 +1,3311 @@
+/*
+ *  Task Scheduling Examples
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <queue>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Size of a cache line; indices written by different threads are kept this far apart
+constexpr std::size_t cache_line_size = 64;
+
+/*
+ * Chase-Lev work-stealing deque: LIFO for the owner, FIFO for thieves
+ */
+
+// Lock-free deque owned by one thread. The owner pushes and pops at the
+// bottom without contention; any number of thieves steal from the top. The
+// circular array grows when full. Memory orderings follow Le et al.,
+// "Correct and Efficient Work-Stealing for Weak Memory Models" (PPoPP 2013).
+template <typename T>
+class WorkStealingDeque {
+	static_assert(std::is_trivially_copyable_v<T>, "elements are copied racily and must be trivially copyable");
+
+	// Power-of-two circular array; slots are atomics because a thief may read
+	// a slot while the owner overwrites it after a lost race
+	struct Array {
+		std::int64_t capacity;
+		std::int64_t mask;
+		std::unique_ptr<std::atomic<T>[]> slots;
+
+		explicit Array(std::int64_t size) : capacity(size), mask(size - 1), slots(new std::atomic<T>[size]) {}
+
+		T get(std::int64_t index) const {
+			return slots[index & mask].load(std::memory_order_relaxed);
+		}
+
+		void put(std::int64_t index, T value) {
+			slots[index & mask].store(value, std::memory_order_relaxed);
+		}
+	};
+
+public:
+	// Constructor; capacity is rounded up to a power of two
+	explicit WorkStealingDeque(std::int64_t capacity = 1024) {
+		std::int64_t size = 2;
+		while (size < capacity) {
+			size <<= 1;
+		}
+		arrays.push_back(std::make_unique<Array>(size));
+		array.store(arrays.back().get(), std::memory_order_relaxed);
+	}
+
+	WorkStealingDeque(const WorkStealingDeque&) = delete;
+	WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+	// Owner only: push at the bottom, growing the array when it is full
+	void push(T value) {
+		const std::int64_t b = bottom.load(std::memory_order_relaxed);
+		const std::int64_t t = top.load(std::memory_order_acquire);
+		Array* a = array.load(std::memory_order_relaxed);
+		if (b - t > a->capacity - 1) {
+			a = grow(a, t, b);
+		}
+		a->put(b, value);
+		// Release store rather than the paper's release fence: same code on
+		// x86, and race detectors can see that it publishes the item
+		bottom.store(b + 1, std::memory_order_release);
+	}
+
+	// Owner only: pop the most recently pushed item (LIFO keeps caches warm)
+	std::optional<T> pop() {
+		const std::int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+		Array* a = array.load(std::memory_order_relaxed);
+		bottom.store(b, std::memory_order_relaxed);
+		// Publish the reservation before looking at top, so a thief cannot take the same item
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		std::int64_t t = top.load(std::memory_order_relaxed);
+		if (t > b) {
+			// Already empty
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return std::nullopt;
+		}
+		T value = a->get(b);
+		if (t == b) {
+			// Last item: race the thieves for it through top
+			const bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+			bottom.store(b + 1, std::memory_order_relaxed);
+			if (!won) {
+				return std::nullopt;
+			}
+		}
+		return value;
+	}
+
+	// Any thread: take the oldest item. Returns nothing when the deque is
+	// empty or another thread won the race for the top item.
+	std::optional<T> steal() {
+		std::int64_t t = top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		const std::int64_t b = bottom.load(std::memory_order_acquire);
+		if (t >= b) {
+			return std::nullopt;
+		}
+		// Read the item before claiming it: once top moves, the owner may reuse the slot
+		T value = array.load(std::memory_order_acquire)->get(t);
+		if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+			return std::nullopt;
+		}
+		return value;
+	}
+
+	// Approximate number of items, for monitoring only
+	std::int64_t size() const {
+		return std::max<std::int64_t>(0, bottom.load(std::memory_order_relaxed) - top.load(std::memory_order_relaxed));
+	}
+
+private:
+	// Owner only: copy live items into an array twice the size. The old array
+	// is retired rather than freed because a thief may still be reading it.
+	Array* grow(Array* old, std::int64_t t, std::int64_t b) {
+		arrays.push_back(std::make_unique<Array>(old->capacity * 2));
+		Array* bigger = arrays.back().get();
+		for (std::int64_t i = t; i < b; ++i) {
+			bigger->put(i, old->get(i));
+		}
+		array.store(bigger, std::memory_order_release);
+		return bigger;
+	}
+
+	// Next slot thieves take; advanced only by compare-and-swap
+	alignas(cache_line_size) std::atomic<std::int64_t> top{0};
+	// Next slot the owner pushes to
+	alignas(cache_line_size) std::atomic<std::int64_t> bottom{0};
+	// Current array, plus every array ever allocated (owner only)
+	alignas(cache_line_size) std::atomic<Array*> array{nullptr};
+	std::vector<std::unique_ptr<Array>> arrays;
+};
+
+int main() {
+	// Stress test: the owner pushes and pops while thieves steal. Every item
+	// must be taken exactly once, through the owner or through a thief.
+	const std::int64_t items = 2000000;
+	const unsigned thieves = 3;
+	// Tiny initial array so the test exercises growth under contention
+	WorkStealingDeque<std::int64_t> deque(4);
+	std::vector<std::atomic<unsigned char>> taken(items);
+	std::atomic<bool> done{false};
+	std::atomic<std::int64_t> stolen{0};
+
+	auto record = [&taken](std::int64_t item) {
+		if (taken[item].fetch_add(1, std::memory_order_relaxed) != 0) {
+			std::cout << "Item " << item << " taken twice" << std::endl;
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (unsigned i = 0; i < thieves; ++i) {
+		threads.emplace_back([&]() {
+			while (!done.load(std::memory_order_acquire) || deque.size() > 0) {
+				if (auto item = deque.steal()) {
+					record(*item);
+					stolen.fetch_add(1, std::memory_order_relaxed);
+				} else {
+					std::this_thread::yield();
+				}
+			}
+		});
+	}
+
+	std::int64_t popped = 0;
+	for (std::int64_t i = 0; i < items; ++i) {
+		deque.push(i);
+		// Pop one in three items locally, leave the rest for the thieves
+		if (i % 3 == 0) {
+			if (auto item = deque.pop()) {
+				record(*item);
+				++popped;
+			}
+		}
+	}
+	while (auto item = deque.pop()) {
+		record(*item);
+		++popped;
+	}
+	done.store(true, std::memory_order_release);
+	for (auto& thread : threads) {
+		thread.join();
+	}
+
+	const auto missing = std::count_if(taken.begin(), taken.end(), [](const auto& flag) { return flag.load() == 0; });
+	std::cout << "Owner popped " << popped << ", thieves stole " << stolen.load() << ", missing " << missing << std::endl;
+	std::cout << (missing == 0 && popped + stolen.load() == items ? "Stress test passed" : "Stress test FAILED") << std::endl;
+	return 0;
+}
+
+// Mutex-protected deque with the same owner/thief interface, as a baseline
+template <typename T>
+class LockedStealingDeque {
+public:
+	void push(T value) {
+		std::lock_guard<std::mutex> lock(mutex);
+		items.push_back(value);
+	}
+
+	std::optional<T> pop() {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (items.empty()) {
+			return std::nullopt;
+		}
+		T value = items.back();
+		items.pop_back();
+		return value;
+	}
+
+	std::optional<T> steal() {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (items.empty()) {
+			return std::nullopt;
+		}
+		T value = items.front();
+		items.pop_front();
+		return value;
+	}
+
+private:
+	std::mutex mutex;
+	std::deque<T> items;
+};
+
+// Owner pushes batches and pops most of them back while thieves steal;
+// returns owner operations per second
+template <typename Deque>
+double benchmark_stealing_deque(unsigned thieves, std::int64_t items) {
+	Deque deque;
+	std::atomic<bool> done{false};
+	std::vector<std::thread> threads;
+	for (unsigned i = 0; i < thieves; ++i) {
+		threads.emplace_back([&deque, &done]() {
+			while (!done.load(std::memory_order_acquire)) {
+				if (!deque.steal()) {
+					std::this_thread::yield();
+				}
+			}
+		});
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+	for (std::int64_t i = 0; i < items; i += 64) {
+		for (std::int64_t j = 0; j < 64; ++j) {
+			deque.push(i + j);
+		}
+		while (deque.pop()) {
+		}
+	}
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	done.store(true, std::memory_order_release);
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	// Each item is pushed once and popped (or lost to a thief) once
+	return 2.0 * items / elapsed.count();
+}
+
+int main() {
+	const std::int64_t items = 10000000;
+	for (unsigned thieves : {0u, 1u, 3u}) {
+		const double lockFree = benchmark_stealing_deque<WorkStealingDeque<std::int64_t>>(thieves, items);
+		const double locked = benchmark_stealing_deque<LockedStealingDeque<std::int64_t>>(thieves, items);
+		std::cout << thieves << " thieves: Chase-Lev " << lockFree / 1e6 << " M ops/sec, mutex deque "
+			<< locked / 1e6 << " M ops/sec" << std::endl;
+	}
+	return 0;
+}
+
+/*
+ * Small-buffer move-only task wrapper
+ */
+
+// Per-thread free lists, one per 64-byte size class, for the small blocks a
+// scheduler churns through: queued jobs, oversized captures, result slots and
+// coroutine frames. Once the lists are warm nothing here calls malloc.
+// Blocks are often freed on another thread than the one that took them, so
+// a thread with too many spare blocks hands a batch to a shared depot and a
+// thread that runs dry takes a batch back; a thread about to sleep hands in
+// everything it holds. The depot is never destroyed and an exiting thread
+// gives its lists to it, so a block may be freed from any thread at any
+// time, even during static destruction.
+class SmallBlockAllocator {
+	static constexpr std::size_t granule = 64;
+	static constexpr std::size_t classes = 16;
+	// Blocks moved between a thread and the depot at a time
+	static constexpr std::size_t batch = 64;
+
+	struct FreeBlock {
+		FreeBlock* next;
+	};
+
+	// A list of free blocks of one size class
+	struct Chain {
+		FreeBlock* head;
+		std::size_t count;
+	};
+
+	// Chains handed in by threads, shared by all threads
+	struct Depot {
+		std::mutex mutex;
+		std::vector<Chain> chains[classes];
+	};
+
+	// Lifetime of the calling thread's cache; trivially destructible, so it
+	// can still be read while the thread's other thread_locals are destroyed
+	enum class CacheState : unsigned char { unused, live, destroyed };
+	static inline thread_local CacheState cache_state = CacheState::unused;
+
+	// One thread's free lists
+	struct Cache {
+		FreeBlock* heads[classes];
+		std::size_t counts[classes];
+
+		Cache() : heads(), counts() {
+			cache_state = CacheState::live;
+		}
+
+		// Give the lists to the depot; blocks freed later bypass the cache
+		~Cache() {
+			cache_state = CacheState::destroyed;
+			give_back();
+		}
+
+		// Move every list to the depot, leaving the cache empty
+		void give_back() {
+			Depot& shared = depot();
+			std::lock_guard<std::mutex> lock(shared.mutex);
+			for (std::size_t index = 0; index < classes; ++index) {
+				if (heads[index]) {
+					shared.chains[index].push_back(Chain{std::exchange(heads[index], nullptr), std::exchange(counts[index], 0)});
+				}
+			}
+		}
+	};
+
+	// The calling thread's cache, or nullptr once it has been destroyed
+	static Cache* local_cache() {
+		if (cache_state == CacheState::destroyed) {
+			return nullptr;
+		}
+		static thread_local Cache cache;
+		return &cache;
+	}
+
+	// Leaked on purpose, so blocks freed during static destruction still have a home
+	static Depot& depot() {
+		static Depot* const shared = new Depot;
+		return *shared;
+	}
+
+public:
+	// Blocks that had to come from the heap, for reporting
+	static inline std::atomic<std::size_t> heap_allocations{0};
+
+	// Hand the calling thread's spare blocks to the depot. For threads about
+	// to sleep: mostly freeing threads would otherwise keep up to two batches
+	// per size class that the allocating threads have to replace from the heap.
+	static void release_local() {
+		if (cache_state == CacheState::live) {
+			local_cache()->give_back();
+		}
+	}
+
+	static void* allocate(std::size_t size) {
+		const std::size_t index = (size + granule - 1) / granule - 1;
+		Cache* cache = index < classes ? local_cache() : nullptr;
+		if (!cache) {
+			heap_allocations.fetch_add(1, std::memory_order_relaxed);
+			return ::operator new(index < classes ? (index + 1) * granule : size);
+		}
+		if (!cache->heads[index]) {
+			Depot& shared = depot();
+			std::lock_guard<std::mutex> lock(shared.mutex);
+			if (!shared.chains[index].empty()) {
+				const Chain chain = shared.chains[index].back();
+				shared.chains[index].pop_back();
+				cache->heads[index] = chain.head;
+				cache->counts[index] = chain.count;
+			}
+		}
+		if (!cache->heads[index]) {
+			heap_allocations.fetch_add(1, std::memory_order_relaxed);
+			return ::operator new((index + 1) * granule);
+		}
+		--cache->counts[index];
+		return std::exchange(cache->heads[index], cache->heads[index]->next);
+	}
+
+	static void deallocate(void* block, std::size_t size) {
+		const std::size_t index = (size + granule - 1) / granule - 1;
+		Cache* cache = index < classes ? local_cache() : nullptr;
+		if (!cache) {
+			::operator delete(block);
+			return;
+		}
+		cache->heads[index] = new (block) FreeBlock{cache->heads[index]};
+		if (++cache->counts[index] < 2 * batch) {
+			return;
+		}
+		// Keep one batch, hand the other to the depot
+		FreeBlock* chain = cache->heads[index];
+		FreeBlock* last = chain;
+		for (std::size_t i = 1; i < batch; ++i) {
+			last = last->next;
+		}
+		cache->heads[index] = std::exchange(last->next, nullptr);
+		cache->counts[index] -= batch;
+		Depot& shared = depot();
+		std::lock_guard<std::mutex> lock(shared.mutex);
+		shared.chains[index].push_back(Chain{chain, batch});
+	}
+};
+
+// Move-only std::function replacement. Callables up to InlineSize bytes
+// live inside the object; larger ones go to SmallBlockAllocator. Either way
+// the common case allocates nothing, and moving an inline callable is a
+// single relocate call through a per-type operations table.
+template <typename Signature, std::size_t InlineSize = 48>
+class UniqueFunction;
+
+template <typename R, typename... Args, std::size_t InlineSize>
+class UniqueFunction<R(Args...), InlineSize> {
+	// What the wrapper needs to know about the stored callable
+	struct Operations {
+		R (*invoke)(void* storage, Args&&... args);
+		// Move the callable to other storage and end the source
+		void (*relocate)(void* from, void* to) noexcept;
+		void (*destroy)(void* storage) noexcept;
+	};
+
+	template <typename F>
+	static constexpr bool stored_inline =
+		sizeof(F) <= InlineSize && alignof(F) <= alignof(std::max_align_t) && std::is_nothrow_move_constructible_v<F>;
+
+	// Callable kept in storage
+	template <typename F>
+	static constexpr Operations inline_operations = {
+		[](void* storage, Args&&... args) -> R { return std::invoke(*static_cast<F*>(storage), std::forward<Args>(args)...); },
+		[](void* from, void* to) noexcept {
+			F* source = static_cast<F*>(from);
+			new (to) F(std::move(*source));
+			source->~F();
+		},
+		[](void* storage) noexcept { static_cast<F*>(storage)->~F(); },
+	};
+
+	// Callable in a pooled block; storage holds the pointer, so moves copy it
+	template <typename F>
+	static constexpr Operations pooled_operations = {
+		[](void* storage, Args&&... args) -> R { return std::invoke(**static_cast<F**>(storage), std::forward<Args>(args)...); },
+		[](void* from, void* to) noexcept { new (to) F*(*static_cast<F**>(from)); },
+		[](void* storage) noexcept {
+			F* callable = *static_cast<F**>(storage);
+			callable->~F();
+			SmallBlockAllocator::deallocate(callable, sizeof(F));
+		},
+	};
+
+public:
+	UniqueFunction() = default;
+
+	template <typename F>
+		requires(!std::is_same_v<std::remove_cvref_t<F>, UniqueFunction> && std::is_invocable_r_v<R, std::decay_t<F>&, Args...>)
+	UniqueFunction(F&& f) {
+		using Callable = std::decay_t<F>;
+		static_assert(alignof(Callable) <= alignof(std::max_align_t), "over-aligned callables are not supported");
+		if constexpr (stored_inline<Callable>) {
+			new (storage) Callable(std::forward<F>(f));
+			operations = &inline_operations<Callable>;
+		} else {
+			void* block = SmallBlockAllocator::allocate(sizeof(Callable));
+			try {
+				new (storage) Callable*(new (block) Callable(std::forward<F>(f)));
+			} catch (...) {
+				SmallBlockAllocator::deallocate(block, sizeof(Callable));
+				throw;
+			}
+			operations = &pooled_operations<Callable>;
+		}
+	}
+
+	UniqueFunction(UniqueFunction&& other) noexcept {
+		take(other);
+	}
+
+	UniqueFunction& operator=(UniqueFunction&& other) noexcept {
+		if (this != &other) {
+			reset();
+			take(other);
+		}
+		return *this;
+	}
+
+	UniqueFunction(const UniqueFunction&) = delete;
+	UniqueFunction& operator=(const UniqueFunction&) = delete;
+
+	~UniqueFunction() {
+		reset();
+	}
+
+	explicit operator bool() const {
+		return operations != nullptr;
+	}
+
+	R operator()(Args... args) {
+		return operations->invoke(storage, std::forward<Args>(args)...);
+	}
+
+private:
+	void take(UniqueFunction& other) noexcept {
+		if (other.operations) {
+			other.operations->relocate(other.storage, storage);
+			operations = std::exchange(other.operations, nullptr);
+		}
+	}
+
+	void reset() {
+		if (operations) {
+			std::exchange(operations, nullptr)->destroy(storage);
+		}
+	}
+
+	alignas(std::max_align_t) unsigned char storage[InlineSize];
+	const Operations* operations = nullptr;
+};
+
+// Create, move twice (into a queue and out again), call and destroy a
+// wrapper around make(i); returns ns per round trip
+template <typename Wrapper, typename Make>
+double time_wrapper(int count, Make make) {
+	long long checksum = 0;
+	const auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < count; ++i) {
+		Wrapper wrapper(make(i));
+		Wrapper queued(std::move(wrapper));
+		Wrapper taken(std::move(queued));
+		if constexpr (requires { taken.get_future(); }) {
+			// std::packaged_task hands its result over through a future
+			auto result = taken.get_future();
+			taken();
+			checksum += result.get();
+		} else {
+			checksum += taken();
+		}
+	}
+	const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+	if (checksum != static_cast<long long>(count) * (count - 1) / 2) {
+		std::cout << "Wrong checksum " << checksum << std::endl;
+	}
+	return elapsed.count() / count;
+}
+
+int main() {
+	const int count = 5000000;
+	// A 40-byte capture: too big for std::function's small buffer, fits UniqueFunction's
+	struct Capture {
+		long long values[5];
+	};
+	auto small = [](int i) { return [capture = Capture{{i, 1, 2, 3, 4}}]() { return capture.values[0]; }; };
+	// A 256-byte capture that falls back to the pool
+	struct LargeCapture {
+		long long values[32];
+	};
+	auto large = [](int i) { return [capture = LargeCapture{{i}}]() { return capture.values[0]; }; };
+
+	std::cout << "sizeof std::function<long long()>: " << sizeof(std::function<long long()>) << ", std::packaged_task<long long()>: "
+		<< sizeof(std::packaged_task<long long()>) << ", UniqueFunction<long long()>: " << sizeof(UniqueFunction<long long()>) << std::endl;
+	std::cout << "40-byte capture, std::function: " << time_wrapper<std::function<long long()>>(count, small) << " ns" << std::endl;
+	std::cout << "40-byte capture, std::packaged_task: " << time_wrapper<std::packaged_task<long long()>>(count, small) << " ns"
+		<< std::endl;
+	std::cout << "40-byte capture, UniqueFunction: " << time_wrapper<UniqueFunction<long long()>>(count, small) << " ns" << std::endl;
+	std::cout << "256-byte capture, std::function: " << time_wrapper<std::function<long long()>>(count, large) << " ns" << std::endl;
+	std::cout << "256-byte capture, UniqueFunction (pooled): " << time_wrapper<UniqueFunction<long long()>>(count, large) << " ns"
+		<< std::endl;
+
+	// A pooled block may outlive every cache: this one is taken on a thread
+	// that exits at once and freed during static destruction
+	static UniqueFunction<long long()> survivor;
+	std::thread([&large]() { survivor = UniqueFunction<long long()>(large(7)); }).join();
+	std::cout << "Pooled capture from an exited thread: " << survivor() << std::endl;
+	return 0;
+}
+
+/*
+ * Allocation-free Promise/Future: one atomic word signals readiness
+ */
+
+template <typename T>
+class FutureStatePool;
+
+template <typename T>
+struct FutureNode;
+
+template <typename T>
+class Promise;
+
+// Result slot shared by one Promise and one Future. It can live inline in
+// the caller's frame or come from a FutureStatePool; neither allocates.
+// FutureState<void> carries only readiness or an exception.
+template <typename T>
+class FutureState {
+	friend class FutureStatePool<T>;
+	friend struct FutureNode<T>;
+	friend class Promise<T>;
+
+	// What storage holds: the value, or an empty placeholder for void
+	struct Unit {};
+	using Stored = std::conditional_t<std::is_void_v<T>, Unit, T>;
+
+	// Values of status
+	static constexpr std::uint32_t empty = 0;
+	// The future is parked and needs a wake-up
+	static constexpr std::uint32_t waiting = 1;
+	static constexpr std::uint32_t ready = 2;
+	// A continuation is registered and runs on publish
+	static constexpr std::uint32_t continued = 3;
+
+public:
+	FutureState() = default;
+	FutureState(const FutureState&) = delete;
+	FutureState& operator=(const FutureState&) = delete;
+
+	~FutureState() {
+		clear();
+	}
+
+	// True once a value or exception has been published
+	bool is_ready() const {
+		return status.load(std::memory_order_acquire) == ready;
+	}
+
+	// Block until ready. Costs one load when the result is already there;
+	// otherwise announces the waiter and parks on the status word.
+	void wait() {
+		std::uint32_t seen = status.load(std::memory_order_acquire);
+		while (seen != ready) {
+			if (seen == empty && !status.compare_exchange_weak(seen, waiting, std::memory_order_acquire)) {
+				continue;
+			}
+			status.wait(waiting, std::memory_order_acquire);
+			seen = status.load(std::memory_order_acquire);
+		}
+	}
+
+	// Wait, then move the value out or rethrow the stored exception
+	T take() {
+		wait();
+		if (error) {
+			std::rethrow_exception(error);
+		}
+		if constexpr (!std::is_void_v<T>) {
+			return std::move(value());
+		}
+	}
+
+	// Construct the value in place and publish it; no arguments for void
+	template <typename... Args>
+	void set_value(Args&&... args) {
+		new (storage) Stored(std::forward<Args>(args)...);
+		publish();
+	}
+
+	// Publish an exception instead of a value
+	void set_exception(std::exception_ptr exception) {
+		error = std::move(exception);
+		publish();
+	}
+
+	// Call callback(context) once ready: right away if the result is already
+	// there, otherwise from the thread that publishes it. Replaces wait();
+	// only one of the two may be used.
+	void on_ready(void (*callback)(void*), void* context) {
+		continuation = callback;
+		continuation_context = context;
+		std::uint32_t expected = empty;
+		if (!status.compare_exchange_strong(expected, continued, std::memory_order_acq_rel, std::memory_order_acquire)) {
+			callback(context);
+		}
+	}
+
+	// Drop one Promise or Future handle; the last one hands an owned state back
+	void release() {
+		if (recycler && handles.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			recycler(owner, this);
+		}
+	}
+
+private:
+	Stored& value() {
+		return *std::launder(reinterpret_cast<Stored*>(storage));
+	}
+
+	// Release the result to the reader; only pay for a wake-up if someone parked
+	void publish() {
+		const std::uint32_t previous = status.exchange(ready, std::memory_order_acq_rel);
+		if (previous == waiting) {
+			status.notify_all();
+		} else if (previous == continued) {
+			continuation(continuation_context);
+		}
+	}
+
+	// Destroy any result and make the slot reusable
+	void clear() {
+		if (status.load(std::memory_order_relaxed) == ready && !error) {
+			value().~Stored();
+		}
+		error = nullptr;
+		continuation = nullptr;
+		status.store(empty, std::memory_order_relaxed);
+	}
+
+	std::atomic<std::uint32_t> status{empty};
+	std::exception_ptr error;
+	alignas(Stored) unsigned char storage[sizeof(Stored)];
+	// Registered by on_ready
+	void (*continuation)(void*) = nullptr;
+	void* continuation_context = nullptr;
+	// Set only for owned states: what the last release() calls, live handles, next free slot
+	void (*recycler)(void* owner, FutureState* state) = nullptr;
+	void* owner = nullptr;
+	std::atomic<std::uint32_t> handles{0};
+	std::atomic<std::uint32_t> next_free{0};
+};
+
+// Fixed slab of FutureStates with a lock-free free list. The list head packs
+// a version tag next to the slot index so a recycled slot cannot cause ABA.
+template <typename T>
+class FutureStatePool {
+public:
+	// Constructor that allocates every state up front
+	explicit FutureStatePool(std::uint32_t capacity) : states(new FutureState<T>[capacity]) {
+		for (std::uint32_t i = 0; i < capacity; ++i) {
+			states[i].owner = this;
+			states[i].recycler = [](void* pool, FutureState<T>* state) { static_cast<FutureStatePool*>(pool)->recycle(state); };
+			// Link i to i + 1; indices are stored plus one so 0 means end of list
+			states[i].next_free.store(i + 1 < capacity ? i + 2 : 0, std::memory_order_relaxed);
+		}
+		head.store(capacity ? 1 : 0, std::memory_order_relaxed);
+	}
+
+	// Take a free state owned by one Promise, or nullptr when exhausted; the
+	// Future handed out by Promise::get_future() adds the second handle
+	FutureState<T>* acquire() {
+		std::uint64_t current = head.load(std::memory_order_acquire);
+		for (;;) {
+			const std::uint32_t index = static_cast<std::uint32_t>(current);
+			if (index == 0) {
+				return nullptr;
+			}
+			FutureState<T>& state = states[index - 1];
+			const std::uint64_t next = ((current >> 32) + 1) << 32 | state.next_free.load(std::memory_order_relaxed);
+			if (head.compare_exchange_weak(current, next, std::memory_order_acquire, std::memory_order_acquire)) {
+				state.handles.store(1, std::memory_order_relaxed);
+				return &state;
+			}
+		}
+	}
+
+	// Return a state whose Promise and Future are both gone
+	void recycle(FutureState<T>* state) {
+		state->clear();
+		const std::uint32_t index = static_cast<std::uint32_t>(state - states.get()) + 1;
+		std::uint64_t current = head.load(std::memory_order_relaxed);
+		for (;;) {
+			state->next_free.store(static_cast<std::uint32_t>(current), std::memory_order_relaxed);
+			const std::uint64_t next = ((current >> 32) + 1) << 32 | index;
+			if (head.compare_exchange_weak(current, next, std::memory_order_release, std::memory_order_relaxed)) {
+				return;
+			}
+		}
+	}
+
+private:
+	std::unique_ptr<FutureState<T>[]> states;
+	// Version tag in the high half, free slot index plus one in the low half
+	std::atomic<std::uint64_t> head{0};
+};
+
+template <typename T>
+class Future;
+
+template <typename T, typename F, typename Executor>
+struct ThenNode;
+
+// What a continuation f returns when fed a T; for void it takes no argument
+template <typename F, typename T>
+struct continuation_result {
+	using type = std::invoke_result_t<F, T>;
+};
+
+template <typename F>
+struct continuation_result<F, void> {
+	using type = std::invoke_result_t<F>;
+};
+
+template <typename F, typename T>
+using continuation_result_t = typename continuation_result<F, T>::type;
+
+// Write side of a FutureState; like std::promise without the heap
+template <typename T>
+class Promise {
+public:
+	// Constructor over a state the caller keeps alive, e.g. on its own stack
+	explicit Promise(FutureState<T>& slot) : state(&slot) {}
+
+	// Constructor over a pooled state
+	explicit Promise(FutureStatePool<T>& pool) : state(pool.acquire()) {
+		if (!state) {
+			throw std::runtime_error("future state pool exhausted");
+		}
+	}
+
+	Promise(Promise&& other) noexcept : state(std::exchange(other.state, nullptr)), fulfilled(other.fulfilled) {}
+	Promise(const Promise&) = delete;
+	Promise& operator=(const Promise&) = delete;
+
+	// Destructor that breaks the promise if it was never kept, so the future does not hang
+	~Promise() {
+		if (state && !fulfilled) {
+			state->set_exception(std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+		}
+		if (state) {
+			state->release();
+		}
+	}
+
+	// Reader side; call once. The future holds its own handle, so a promise
+	// whose future is never taken still returns a pooled state on its own.
+	Future<T> get_future() {
+		state->handles.fetch_add(1, std::memory_order_relaxed);
+		return Future<T>(state);
+	}
+
+	template <typename... Args>
+	void set_value(Args&&... args) {
+		fulfilled = true;
+		state->set_value(std::forward<Args>(args)...);
+	}
+
+	void set_exception(std::exception_ptr exception) {
+		fulfilled = true;
+		state->set_exception(std::move(exception));
+	}
+
+private:
+	FutureState<T>* state;
+	bool fulfilled = false;
+};
+
+// Read side of a FutureState; like std::future without the mutex and condvar
+template <typename T>
+class Future {
+	friend class Promise<T>;
+	friend struct FutureNode<T>;
+
+	explicit Future(FutureState<T>* slot) : state(slot) {}
+
+public:
+	Future() = default;
+	Future(Future&& other) noexcept : state(std::exchange(other.state, nullptr)) {}
+
+	Future& operator=(Future&& other) noexcept {
+		if (this != &other) {
+			reset();
+			state = std::exchange(other.state, nullptr);
+		}
+		return *this;
+	}
+
+	~Future() {
+		reset();
+	}
+
+	bool valid() const {
+		return state != nullptr;
+	}
+
+	bool is_ready() const {
+		return state->is_ready();
+	}
+
+	void wait() const {
+		state->wait();
+	}
+
+	// Block until ready and return the value; the future is left invalid
+	T get() {
+		FutureState<T>* slot = std::exchange(state, nullptr);
+		struct Release {
+			FutureState<T>* slot;
+			~Release() {
+				slot->release();
+			}
+		} release{slot};
+		return slot->take();
+	}
+
+	// Call callback(context) once the result is ready instead of blocking;
+	// the combinators below are built on this
+	void on_ready(void (*callback)(void*), void* context) {
+		state->on_ready(callback, context);
+	}
+
+	// Run f(value) (f() for a void future) on executor once the result is
+	// ready, without blocking any thread, and return a future for its result.
+	// Consumes this future.
+	template <typename Executor, typename F>
+	auto then(Executor& executor, F&& f) -> Future<continuation_result_t<F, T>> {
+		auto* node = new ThenNode<T, std::decay_t<F>, Executor>(std::move(*this), std::forward<F>(f), executor);
+		return node->start();
+	}
+
+private:
+	void reset() {
+		if (state) {
+			std::exchange(state, nullptr)->release();
+		}
+	}
+
+	FutureState<T>* state = nullptr;
+};
+
+// Heap-allocated FutureState for async_on and the combinators. The node deletes itself
+// once its producer side and the returned Future have both released it.
+template <typename T>
+struct FutureNode {
+	FutureState<T> result;
+
+	FutureNode() {
+		result.owner = this;
+		result.recycler = [](void* node, FutureState<T>*) { delete static_cast<FutureNode*>(node); };
+		result.handles.store(2, std::memory_order_relaxed);
+	}
+
+	virtual ~FutureNode() = default;
+
+	// Nodes are small and short-lived; the virtual destructor passes the real size
+	static void* operator new(std::size_t size) {
+		return SmallBlockAllocator::allocate(size);
+	}
+
+	static void operator delete(void* node, std::size_t size) {
+		SmallBlockAllocator::deallocate(node, size);
+	}
+
+	Future<T> get_future() {
+		return Future<T>(&result);
+	}
+};
+
+// Publish what f() returns, or what it throws, into state
+template <typename R, typename F>
+void set_from_call(FutureState<R>& state, F&& f) {
+	try {
+		if constexpr (std::is_void_v<R>) {
+			std::invoke(std::forward<F>(f));
+			state.set_value();
+		} else {
+			state.set_value(std::invoke(std::forward<F>(f)));
+		}
+	} catch (...) {
+		state.set_exception(std::current_exception());
+	}
+}
+
+// A callable fused with its result slot in one pooled block, so starting it
+// costs one block however large the capture is
+template <typename R, typename F>
+struct InlineTask final : FutureNode<R> {
+	F function;
+
+	explicit InlineTask(F&& f) : function(std::move(f)) {}
+
+	void run() {
+		set_from_call(this->result, std::move(function));
+		this->result.release();
+	}
+};
+
+// Run f() on executor and return a Future for its result
+template <typename Executor, typename F>
+auto async_on(Executor& executor, F&& f) -> Future<std::invoke_result_t<F>> {
+	using Result = std::invoke_result_t<F>;
+	auto* task = new InlineTask<Result, std::decay_t<F>>(std::forward<F>(f));
+	Future<Result> result = task->get_future();
+	// The job captures one pointer, so its UniqueFunction stores it inline
+	executor.spawn([task]() { task->run(); });
+	return result;
+}
+
+int main() {
+	// The promise example from thread_synchronization_demo.cpp, with the
+	// shared state on this stack frame instead of the heap
+	FutureState<int> state;
+	Promise<int> promise(state);
+	Future<int> future = promise.get_future();
+	std::thread promiseThread([&promise]() {
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		promise.set_value(6);
+	});
+	std::cout << "Promise result: " << future.get() << std::endl;
+	promiseThread.join();
+
+	// A promise that is dropped unfulfilled reports broken_promise instead of hanging
+	FutureStatePool<int> pool(16);
+	Future<int> orphan;
+	{
+		Promise<int> abandoned(pool);
+		orphan = abandoned.get_future();
+	}
+	try {
+		orphan.get();
+	} catch (const std::future_error& error) {
+		std::cout << "Abandoned promise: " << error.what() << std::endl;
+	}
+
+	// Promises whose future is never taken still hand their state back
+	for (int i = 0; i < 1000; ++i) {
+		Promise<int> unread(pool);
+		unread.set_value(i);
+	}
+	std::cout << "1000 unread promises through a pool of 16" << std::endl;
+	return 0;
+}
+
+// Time count fulfilled-before-get handoffs made by handoff(i); returns ns per handoff
+template <typename Handoff>
+double time_handoffs(int count, Handoff handoff) {
+	long long checksum = 0;
+	const auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < count; ++i) {
+		checksum += handoff(i);
+	}
+	const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+	if (checksum != static_cast<long long>(count) * (count - 1) / 2) {
+		std::cout << "Wrong checksum " << checksum << std::endl;
+	}
+	return elapsed.count() / count;
+}
+
+int main() {
+	const int count = 5000000;
+	const double inlineState = time_handoffs(count, [](int i) {
+		FutureState<int> state;
+		Promise<int> promise(state);
+		Future<int> future = promise.get_future();
+		promise.set_value(i);
+		return future.get();
+	});
+	FutureStatePool<int> pool(64);
+	const double pooled = time_handoffs(count, [&pool](int i) {
+		Promise<int> promise(pool);
+		Future<int> future = promise.get_future();
+		promise.set_value(i);
+		return future.get();
+	});
+	const double standard = time_handoffs(count, [](int i) {
+		std::promise<int> promise;
+		std::future<int> future = promise.get_future();
+		promise.set_value(i);
+		return future.get();
+	});
+	std::cout << "Inline FutureState: " << inlineState << " ns per handoff" << std::endl;
+	std::cout << "Pooled FutureState: " << pooled << " ns per handoff" << std::endl;
+	std::cout << "std::promise/std::future: " << standard << " ns per handoff" << std::endl;
+	return 0;
+}
+
+/*
+ * Fixed-size thread pool with submit(f, args...) -> Future
+ */
+
+// Compute the factorial of n, as in thread_synchronization_demo.cpp
+int factorial(int n) {
+	int result = 1;
+	for (int i = n; i > 1; --i) {
+		result *= i;
+	}
+	return result;
+}
+
+// Workers are created once and reused for every task, instead of one OS
+// thread per std::async call. Tasks wait in a circular buffer that only
+// reallocates when it has to grow, so enqueueing does not allocate.
+class ThreadPool {
+	// A submitted job captures one InlineTask pointer, so it fits inline
+	using Task = UniqueFunction<void()>;
+
+public:
+	// Constructor that starts one worker per hardware thread by default
+	explicit ThreadPool(unsigned threads = std::max(1u, std::thread::hardware_concurrency())) : tasks(256) {
+		for (unsigned i = 0; i < threads; ++i) {
+			workers.emplace_back([this]() { work(); });
+		}
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// Destructor that runs every queued task, then joins the workers
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (auto& worker : workers) {
+			worker.join();
+		}
+	}
+
+	// Queue f(args...) and return a Future for its result. The call and its
+	// result share one pooled block instead of a packaged_task plus a
+	// heap-allocated shared state.
+	template <typename F, typename... Args>
+	auto submit(F&& f, Args&&... args) -> Future<std::invoke_result_t<F, Args...>> {
+		return async_on(*this,
+			[f = std::forward<F>(f), ... args = std::forward<Args>(args)]() mutable { return std::invoke(std::move(f), std::move(args)...); });
+	}
+
+	// Queue f() without a result; f must not throw
+	template <typename F>
+	void spawn(F&& f) {
+		enqueue(Task(std::forward<F>(f)));
+	}
+
+	// Number of worker threads
+	std::size_t size() const {
+		return workers.size();
+	}
+
+private:
+	// Append to the circular buffer, doubling it when full
+	void enqueue(Task task) {
+		bool wakeOne;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (count == tasks.size()) {
+				std::vector<Task> bigger(tasks.size() * 2);
+				for (std::size_t i = 0; i < count; ++i) {
+					bigger[i] = std::move(tasks[(head + i) % tasks.size()]);
+				}
+				tasks = std::move(bigger);
+				head = 0;
+			}
+			tasks[(head + count) % tasks.size()] = std::move(task);
+			++count;
+			// Busy workers will find the task on their own; only wake a sleeper
+			wakeOne = idle > 0;
+		}
+		if (wakeOne) {
+			wake.notify_one();
+		}
+	}
+
+	// Worker loop: take the oldest task, run it outside the lock, block when idle
+	void work() {
+		for (;;) {
+			Task task;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				++idle;
+				wake.wait(lock, [this]() { return count > 0 || stopping; });
+				--idle;
+				if (count == 0) {
+					return;
+				}
+				task = std::move(tasks[head]);
+				head = (head + 1) % tasks.size();
+				--count;
+			}
+			task();
+		}
+	}
+
+	// Guards the task buffer, idle count and stopping flag
+	std::mutex mutex;
+	// Signaled when a task arrives or the pool is shutting down
+	std::condition_variable wake;
+	// Circular task buffer: count tasks starting at head
+	std::vector<Task> tasks;
+	std::size_t head = 0;
+	std::size_t count = 0;
+	// Workers currently blocked waiting for a task
+	unsigned idle = 0;
+	bool stopping = false;
+	std::vector<std::thread> workers;
+};
+
+int main() {
+	// The std::async, std::promise and std::packaged_task examples from
+	// thread_synchronization_demo.cpp, running on pool threads instead of new ones
+	ThreadPool pool;
+	Future<int> futureResult = pool.submit(factorial, 5);
+	std::cout << "Factorial result: " << futureResult.get() << std::endl;
+
+	std::promise<int> promise;
+	std::future<int> future = promise.get_future();
+	pool.submit([&promise]() {
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		promise.set_value(6);
+	});
+	std::cout << "Promise result: " << future.get() << std::endl;
+
+	Future<int> taskFuture = pool.submit(factorial, 4);
+	std::cout << "Packaged task result: " << taskFuture.get() << std::endl;
+	return 0;
+}
+
+// Submit count tiny tasks through submit and wait for all of them; returns tasks per second
+template <typename Submit>
+double benchmark_tiny_tasks(std::size_t count, Submit submit) {
+	std::vector<std::invoke_result_t<Submit&>> futures;
+	futures.reserve(count);
+	const auto start = std::chrono::steady_clock::now();
+	for (std::size_t i = 0; i < count; ++i) {
+		futures.push_back(submit());
+	}
+	long long checksum = 0;
+	for (auto& future : futures) {
+		checksum += future.get();
+	}
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	if (checksum != 120LL * static_cast<long long>(count)) {
+		std::cout << "Wrong checksum " << checksum << std::endl;
+	}
+	return count / elapsed.count();
+}
+
+int main() {
+	// factorial(5) is far cheaper than creating a thread, so per-call std::async
+	// is dominated by thread start-up while the pool only pays for queueing
+	ThreadPool pool;
+	const double pooled = benchmark_tiny_tasks(1000000, [&pool]() { return pool.submit(factorial, 5); });
+	const double async = benchmark_tiny_tasks(20000, []() { return std::async(std::launch::async, factorial, 5); });
+	std::cout << "ThreadPool (" << pool.size() << " workers): " << pooled << " tasks/sec" << std::endl;
+	std::cout << "std::async: " << async << " tasks/sec" << std::endl;
+	std::cout << "Speedup: " << pooled / async << "x" << std::endl;
+	return 0;
+}
+
+/*
+ * Work-stealing executor: per-worker deques, random victims, global injection queue
+ */
+
+// Each worker owns a Chase-Lev deque. Tasks spawned by a running task go to
+// its worker's deque, so divide-and-conquer work stays on one core until
+// someone is idle. Idle workers steal the oldest task of a random victim.
+// Submissions from outside the pool land in a shared injection queue.
+class WorkStealingExecutor {
+	// Unit of work. The deques hold pointers, so each job sits in a pooled
+	// block and spawning does not call malloc once the pool is warm.
+	using Job = UniqueFunction<void()>;
+
+	// Per-worker state, padded so neighbouring deques do not share lines
+	struct alignas(cache_line_size) Worker {
+		WorkStealingDeque<Job*> deque;
+		// xorshift state for picking victims
+		std::uint32_t seed;
+		std::thread thread;
+	};
+
+public:
+	// Constructor that starts one worker per hardware thread by default
+	explicit WorkStealingExecutor(unsigned threads = std::max(1u, std::thread::hardware_concurrency())) {
+		for (unsigned i = 0; i < threads; ++i) {
+			workers.push_back(std::make_unique<Worker>());
+			workers.back()->seed = 0x9e3779b9u * (i + 1);
+		}
+		for (unsigned i = 0; i < threads; ++i) {
+			workers[i]->thread = std::thread([this, i]() { work(*workers[i]); });
+		}
+	}
+
+	WorkStealingExecutor(const WorkStealingExecutor&) = delete;
+	WorkStealingExecutor& operator=(const WorkStealingExecutor&) = delete;
+
+	// Destructor that finishes every queued task, then joins the workers
+	~WorkStealingExecutor() {
+		stopping.store(true, std::memory_order_seq_cst);
+		epoch.fetch_add(1, std::memory_order_seq_cst);
+		epoch.notify_all();
+		for (auto& worker : workers) {
+			worker->thread.join();
+		}
+	}
+
+	// Run f() on some worker, without a result. f must not throw: there is
+	// nobody to hand the exception to (use TaskGroup or submit() for that).
+	template <typename F>
+	void spawn(F&& f) {
+		void* block = SmallBlockAllocator::allocate(sizeof(Job));
+		schedule(new (block) Job(std::forward<F>(f)));
+	}
+
+	// Queue f(args...) and return a Future for its result, like ThreadPool::submit
+	template <typename F, typename... Args>
+	auto submit(F&& f, Args&&... args) -> Future<std::invoke_result_t<F, Args...>> {
+		return async_on(*this,
+			[f = std::forward<F>(f), ... args = std::forward<Args>(args)]() mutable { return std::invoke(std::move(f), std::move(args)...); });
+	}
+
+	// Run other tasks until done() holds. Lets a task wait for its children
+	// without blocking the worker thread it runs on.
+	template <typename Predicate>
+	void run_until(Predicate done) {
+		Worker* self = current_executor == this ? current_worker : nullptr;
+		while (!done()) {
+			if (Job* job = find_job(self)) {
+				run(job);
+			} else {
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	// Number of worker threads
+	std::size_t size() const {
+		return workers.size();
+	}
+
+private:
+	// Workers push onto their own deque; everybody else uses the injection queue
+	void schedule(Job* job) {
+		if (current_executor == this) {
+			current_worker->deque.push(job);
+		} else {
+			std::lock_guard<std::mutex> lock(injection_mutex);
+			injection.push_back(job);
+			injected.fetch_add(1, std::memory_order_relaxed);
+		}
+		// Pairs with the fence in park(): either the sleeper sees the job or we see the sleeper
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (sleepers.load(std::memory_order_relaxed) > 0) {
+			epoch.fetch_add(1, std::memory_order_seq_cst);
+			epoch.notify_one();
+		}
+	}
+
+	// xorshift state for threads outside the pool that help in run_until,
+	// seeded once per thread so concurrent helpers start at different victims
+	static std::uint32_t& outside_seed() {
+		static std::atomic<std::uint32_t> threads{0};
+		thread_local std::uint32_t seed = 0x85ebca6bu * (threads.fetch_add(1, std::memory_order_relaxed) + 1) | 1;
+		return seed;
+	}
+
+	// Own deque first (newest task), then the injection queue, then a random victim
+	Job* find_job(Worker* self) {
+		if (self) {
+			if (auto job = self->deque.pop()) {
+				return *job;
+			}
+		}
+		if (injected.load(std::memory_order_relaxed) > 0) {
+			std::lock_guard<std::mutex> lock(injection_mutex);
+			if (!injection.empty()) {
+				Job* job = injection.front();
+				injection.pop_front();
+				injected.fetch_sub(1, std::memory_order_relaxed);
+				return job;
+			}
+		}
+		const std::size_t count = workers.size();
+		std::uint32_t& seed = self ? self->seed : outside_seed();
+		// Start at a random victim and try each worker once
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		for (std::size_t i = 0; i < count; ++i) {
+			Worker& victim = *workers[(seed + i) % count];
+			if (&victim == self) {
+				continue;
+			}
+			if (auto job = victim.deque.steal()) {
+				return *job;
+			}
+		}
+		return nullptr;
+	}
+
+	static void run(Job* job) {
+		(*job)();
+		job->~Job();
+		SmallBlockAllocator::deallocate(job, sizeof(Job));
+	}
+
+	// Worker loop: run tasks while there are any, spin-yield briefly, then park
+	void work(Worker& self) {
+		current_executor = this;
+		current_worker = &self;
+		for (;;) {
+			Job* job = nullptr;
+			for (int attempt = 0; attempt < 64 && !job; ++attempt) {
+				job = find_job(&self);
+				if (!job) {
+					std::this_thread::yield();
+				}
+			}
+			if (job) {
+				run(job);
+				continue;
+			}
+			if (!park(self)) {
+				return;
+			}
+		}
+	}
+
+	// Sleep until a job is scheduled. Returns false when the executor is
+	// stopping and no work is left.
+	bool park(Worker& self) {
+		sleepers.fetch_add(1, std::memory_order_seq_cst);
+		const std::uint32_t seen = epoch.load(std::memory_order_seq_cst);
+		// Rescan after announcing ourselves, so a job scheduled meanwhile is not missed
+		if (Job* job = find_job(&self)) {
+			sleepers.fetch_sub(1, std::memory_order_relaxed);
+			run(job);
+			return true;
+		}
+		if (stopping.load(std::memory_order_seq_cst)) {
+			sleepers.fetch_sub(1, std::memory_order_relaxed);
+			return false;
+		}
+		SmallBlockAllocator::release_local();
+		epoch.wait(seen, std::memory_order_seq_cst);
+		sleepers.fetch_sub(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	std::vector<std::unique_ptr<Worker>> workers;
+	// Jobs submitted from outside the pool, oldest first
+	std::mutex injection_mutex;
+	std::deque<Job*> injection;
+	// Size of the injection queue, read without the lock to skip it when empty
+	std::atomic<std::size_t> injected{0};
+	// Parked workers and the word they sleep on
+	alignas(cache_line_size) std::atomic<unsigned> sleepers{0};
+	std::atomic<std::uint32_t> epoch{0};
+	std::atomic<bool> stopping{false};
+
+	// Executor and worker the calling thread belongs to, if any
+	static inline thread_local WorkStealingExecutor* current_executor = nullptr;
+	static inline thread_local Worker* current_worker = nullptr;
+};
+
+// Fork-join helper: spawn child tasks, then wait for all of them while
+// running other work on the waiting thread. The first exception thrown by a
+// child is kept and rethrown from wait(); the others are dropped.
+class TaskGroup {
+public:
+	explicit TaskGroup(WorkStealingExecutor& owner) : executor(owner) {}
+
+	// Destructor that never leaves children running against a dead group.
+	// An exception nobody collected with wait() is discarded.
+	~TaskGroup() {
+		join();
+	}
+
+	// Spawn f() as a child of this group
+	template <typename F>
+	void run(F&& f) {
+		pending.fetch_add(1, std::memory_order_relaxed);
+		executor.spawn([this, f = std::forward<F>(f)]() mutable {
+			try {
+				f();
+			} catch (...) {
+				// First failure wins; the release below publishes it to wait()
+				if (!failed.exchange(true, std::memory_order_relaxed)) {
+					failure = std::current_exception();
+				}
+			}
+			pending.fetch_sub(1, std::memory_order_release);
+		});
+	}
+
+	// Help the executor until every child has finished, then rethrow the
+	// first exception a child threw
+	void wait() {
+		join();
+		if (failure) {
+			failed.store(false, std::memory_order_relaxed);
+			std::rethrow_exception(std::exchange(failure, nullptr));
+		}
+	}
+
+private:
+	void join() {
+		executor.run_until([this]() { return pending.load(std::memory_order_acquire) == 0; });
+	}
+
+	WorkStealingExecutor& executor;
+	std::atomic<std::size_t> pending{0};
+	// Set by the first child that throws, which then owns failure
+	std::atomic<bool> failed{false};
+	std::exception_ptr failure;
+};
+
+// Naive recursive Fibonacci, the sequential leaf of the benchmark
+long long fibonacci(int n) {
+	return n < 2 ? n : fibonacci(n - 1) + fibonacci(n - 2);
+}
+
+// Divide and conquer: fork one branch, compute the other inline, join
+long long parallel_fibonacci(WorkStealingExecutor& executor, int n) {
+	if (n < 20) {
+		return fibonacci(n);
+	}
+	long long left = 0;
+	TaskGroup group(executor);
+	group.run([&executor, &left, n]() { left = parallel_fibonacci(executor, n - 1); });
+	const long long right = parallel_fibonacci(executor, n - 2);
+	group.wait();
+	return left + right;
+}
+
+int main() {
+	// Drop-in for the std::async and std::packaged_task calls in the demo
+	WorkStealingExecutor executor;
+	Future<int> futureResult = executor.submit(factorial, 5);
+	std::cout << "Factorial result: " << futureResult.get() << std::endl;
+	Future<int> taskFuture = executor.submit(factorial, 4);
+	std::cout << "Packaged task result: " << taskFuture.get() << std::endl;
+
+	// Tasks spawned inside a task go to the local deque
+	Future<long long> fib = executor.submit([&executor]() { return parallel_fibonacci(executor, 30); });
+	std::cout << "fibonacci(30) = " << fib.get() << std::endl;
+
+	// A throwing child does not take the worker down; wait() rethrows it
+	std::atomic<int> finished{0};
+	try {
+		TaskGroup group(executor);
+		for (int i = 0; i < 8; ++i) {
+			group.run([&finished, i]() {
+				if (i == 3) {
+					throw std::runtime_error("child 3 failed");
+				}
+				finished.fetch_add(1);
+			});
+		}
+		group.wait();
+	} catch (const std::runtime_error& error) {
+		std::cout << "TaskGroup rethrew: " << error.what() << " (" << finished.load() << " siblings finished)" << std::endl;
+	}
+	return 0;
+}
+
+int main() {
+	// Scaling on a recursive workload; speedup is relative to plain recursion
+	const int n = 38;
+	auto start = std::chrono::steady_clock::now();
+	const long long expected = fibonacci(n);
+	const std::chrono::duration<double> sequential = std::chrono::steady_clock::now() - start;
+	std::cout << "Sequential: " << sequential.count() * 1000 << " ms" << std::endl;
+
+	const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+	for (unsigned threads = 1; threads <= std::max(cores, 4u); threads *= 2) {
+		WorkStealingExecutor executor(threads);
+		start = std::chrono::steady_clock::now();
+		const long long result = executor.submit([&executor, n]() { return parallel_fibonacci(executor, n); }).get();
+		const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		std::cout << threads << " workers: " << elapsed.count() * 1000 << " ms, speedup " << sequential.count() / elapsed.count()
+			<< "x" << (result == expected ? "" : " WRONG RESULT") << std::endl;
+	}
+	std::cout << "(hardware threads: " << cores << ")" << std::endl;
+	return 0;
+}
+
+/*
+ * Future continuations: then, when_all, when_any
+ */
+
+// Continuation created by Future::then: schedules function on the executor
+// when the source is ready and publishes what it returns
+template <typename T, typename F, typename Executor>
+struct ThenNode final : FutureNode<continuation_result_t<F, T>> {
+	using Result = continuation_result_t<F, T>;
+
+	Future<T> source;
+	F function;
+	Executor& executor;
+
+	ThenNode(Future<T>&& input, F&& f, Executor& runner) : source(std::move(input)), function(std::move(f)), executor(runner) {}
+
+	Future<Result> start() {
+		Future<Result> future = this->get_future();
+		source.on_ready(&ThenNode::ready, this);
+		return future;
+	}
+
+	// Runs on whichever thread published the source; only queues the work
+	static void ready(void* context) {
+		auto* node = static_cast<ThenNode*>(context);
+		node->executor.spawn([node]() { node->run(); });
+	}
+
+	void run() {
+		set_from_call(this->result, [this]() -> Result {
+			if constexpr (std::is_void_v<T>) {
+				source.get();
+				return std::invoke(std::move(function));
+			} else {
+				return std::invoke(std::move(function), source.get());
+			}
+		});
+		this->result.release();
+	}
+};
+
+// What when_all resolves to: a tuple of the values, or nothing when every source is void
+template <typename... T>
+using when_all_result_t = std::conditional_t<(std::is_void_v<T> && ...), void, std::tuple<T...>>;
+
+// What when_any resolves to: the winner's index and value, or only its index for void
+template <typename T>
+using when_any_result_t = std::conditional_t<std::is_void_v<T>, std::size_t, std::pair<std::size_t, T>>;
+
+// Completes when every source has; the last source to finish builds the tuple
+template <typename... T>
+struct WhenAllNode final : FutureNode<when_all_result_t<T...>> {
+	using Result = when_all_result_t<T...>;
+
+	std::tuple<Future<T>...> sources;
+	std::atomic<std::size_t> remaining{sizeof...(T)};
+
+	explicit WhenAllNode(Future<T>&&... futures) : sources(std::move(futures)...) {}
+
+	Future<Result> start() {
+		Future<Result> future = this->get_future();
+		std::apply([this](auto&... source) { (source.on_ready(&WhenAllNode::ready, this), ...); }, sources);
+		return future;
+	}
+
+	static void ready(void* context) {
+		auto* node = static_cast<WhenAllNode*>(context);
+		if (node->remaining.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+			return;
+		}
+		try {
+			if constexpr (std::is_void_v<Result>) {
+				std::apply([](auto&... source) { (source.get(), ...); }, node->sources);
+				node->result.set_value();
+			} else {
+				node->result.set_value(std::apply([](auto&... source) { return Result(source.get()...); }, node->sources));
+			}
+		} catch (...) {
+			node->result.set_exception(std::current_exception());
+		}
+		node->result.release();
+	}
+};
+
+// Future for all results at once; an exception from any source is passed on.
+// Sources are either all void, giving a Future<void>, or all non-void.
+template <typename... T>
+Future<when_all_result_t<T...>> when_all(Future<T>&&... futures) {
+	static_assert(sizeof...(T) > 0, "when_all needs at least one future");
+	static_assert(std::is_void_v<when_all_result_t<T...>> || (!std::is_void_v<T> && ...), "when_all cannot mix void and non-void futures");
+	return (new WhenAllNode<T...>(std::move(futures)...))->start();
+}
+
+// Completes with the first source to finish; stays alive until all have
+template <typename T>
+struct WhenAnyNode final : FutureNode<when_any_result_t<T>> {
+	// Callback context for one source
+	struct Source {
+		WhenAnyNode* node;
+		std::size_t index;
+		Future<T> future;
+	};
+
+	std::vector<Source> sources;
+	std::atomic<bool> decided{false};
+	std::atomic<std::size_t> remaining;
+
+	explicit WhenAnyNode(std::vector<Future<T>>&& futures) : remaining(futures.size()) {
+		sources.reserve(futures.size());
+		for (std::size_t i = 0; i < futures.size(); ++i) {
+			sources.push_back(Source{this, i, std::move(futures[i])});
+		}
+	}
+
+	Future<when_any_result_t<T>> start() {
+		Future<when_any_result_t<T>> future = this->get_future();
+		for (Source& source : sources) {
+			source.future.on_ready(&WhenAnyNode::ready, &source);
+		}
+		return future;
+	}
+
+	static void ready(void* context) {
+		Source& source = *static_cast<Source*>(context);
+		WhenAnyNode* node = source.node;
+		if (!node->decided.exchange(true, std::memory_order_acq_rel)) {
+			try {
+				if constexpr (std::is_void_v<T>) {
+					source.future.get();
+					node->result.set_value(source.index);
+				} else {
+					node->result.set_value(source.index, source.future.get());
+				}
+			} catch (...) {
+				node->result.set_exception(std::current_exception());
+			}
+		}
+		if (node->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			node->result.release();
+		}
+	}
+};
+
+// Future for the index and value of whichever source finishes first; for
+// void sources only the index
+template <typename T>
+Future<when_any_result_t<T>> when_any(std::vector<Future<T>> futures) {
+	if (futures.empty()) {
+		throw std::invalid_argument("when_any needs at least one future");
+	}
+	return (new WhenAnyNode<T>(std::move(futures)))->start();
+}
+
+int main() {
+	// At least two workers, so the slow racer below cannot hold up everything else
+	WorkStealingExecutor executor(std::max(2u, std::thread::hardware_concurrency()));
+
+	// factorial -> format -> log: each step is queued when the previous
+	// result arrives, so no thread blocks between the steps
+	Future<void> logged = async_on(executor, []() { return factorial(5); })
+		.then(executor, [](int value) { return "Factorial result: " + std::to_string(value); })
+		.then(executor, [](std::string line) { std::cout << line << std::endl; });
+
+	// Fan-in: sum several factorials once all of them are known
+	Future<int> sum = when_all(async_on(executor, []() { return factorial(3); }), async_on(executor, []() { return factorial(4); }),
+		async_on(executor, []() { return factorial(6); }))
+		.then(executor, [](std::tuple<int, int, int> values) { return std::get<0>(values) + std::get<1>(values) + std::get<2>(values); });
+
+	// Race: the fast computation wins against the slow one
+	std::vector<Future<int>> racers;
+	racers.push_back(async_on(executor, []() {
+		std::this_thread::sleep_for(std::chrono::milliseconds(200));
+		return factorial(7);
+	}));
+	racers.push_back(async_on(executor, []() { return factorial(2); }));
+	Future<std::pair<std::size_t, int>> first = when_any(std::move(racers));
+
+	// Void futures combine too: when_all gives a Future<void>, when_any the winner's index
+	std::atomic<int> warmed{0};
+	Future<void> warmedUp = when_all(async_on(executor, [&warmed]() { ++warmed; }), async_on(executor, [&warmed]() { ++warmed; }));
+	std::vector<Future<void>> pings;
+	pings.push_back(async_on(executor, []() {}));
+	pings.push_back(async_on(executor, []() { std::this_thread::sleep_for(std::chrono::milliseconds(100)); }));
+	Future<std::size_t> firstPing = when_any(std::move(pings));
+
+	// main blocks only here, once per final result
+	logged.get();
+	std::cout << "3! + 4! + 6! = " << sum.get() << std::endl;
+	const auto [index, value] = first.get();
+	std::cout << "First finished: racer " << index << " with " << value << std::endl;
+	warmedUp.get();
+	std::cout << "Warm-up steps done: " << warmed.load() << std::endl;
+	std::cout << "First ping: " << firstPing.get() << std::endl;
+	return 0;
+}
+
+/*
+ * C++20 coroutine Task<T> on the work-stealing executor
+ */
+
+// Executor that resumes the coroutine owning promise, or nullptr when it has none
+template <typename Promise>
+WorkStealingExecutor* executor_of(std::coroutine_handle<Promise> handle) {
+	if constexpr (requires { handle.promise().executor; }) {
+		return handle.promise().executor;
+	} else {
+		return nullptr;
+	}
+}
+
+// Every awaiter resumes through here, so a woken coroutine runs on a pool
+// worker rather than on the timer, producer or unlocking thread
+inline void resume_on(WorkStealingExecutor* executor, std::coroutine_handle<> handle) {
+	if (executor) {
+		executor->spawn([handle]() { handle.resume(); });
+	} else {
+		handle.resume();
+	}
+}
+
+template <typename T>
+class Task;
+
+// Promise parts shared by Task<T> and Task<void>
+struct TaskPromiseBase {
+	// Resumed when the task finishes; the awaiting coroutine, if any
+	std::coroutine_handle<> continuation = std::noop_coroutine();
+	// Inherited from the awaiting task; wake-ups are scheduled here
+	WorkStealingExecutor* executor = nullptr;
+	std::exception_ptr error;
+
+	// Hand control straight to the awaiting coroutine (symmetric transfer)
+	struct FinalAwaiter {
+		bool await_ready() const noexcept {
+			return false;
+		}
+
+		template <typename Promise>
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+			return handle.promise().continuation;
+		}
+
+		void await_resume() const noexcept {}
+	};
+
+	// Tasks are lazy: nothing runs until someone awaits them
+	std::suspend_always initial_suspend() const noexcept {
+		return {};
+	}
+
+	FinalAwaiter final_suspend() const noexcept {
+		return {};
+	}
+
+	void unhandled_exception() {
+		error = std::current_exception();
+	}
+
+	static void* operator new(std::size_t size) {
+		return SmallBlockAllocator::allocate(size);
+	}
+
+	static void operator delete(void* frame, std::size_t size) {
+		SmallBlockAllocator::deallocate(frame, size);
+	}
+};
+
+template <typename T>
+struct TaskPromise : TaskPromiseBase {
+	std::optional<T> value;
+
+	Task<T> get_return_object() {
+		return Task<T>(std::coroutine_handle<TaskPromise>::from_promise(*this));
+	}
+
+	template <typename U>
+	void return_value(U&& result) {
+		value.emplace(std::forward<U>(result));
+	}
+
+	T result() {
+		if (error) {
+			std::rethrow_exception(error);
+		}
+		return std::move(*value);
+	}
+};
+
+template <>
+struct TaskPromise<void> : TaskPromiseBase {
+	Task<void> get_return_object();
+
+	void return_void() const noexcept {}
+
+	void result() const {
+		if (error) {
+			std::rethrow_exception(error);
+		}
+	}
+};
+
+// Lazily started coroutine producing a T. co_await runs it on the awaiting
+// coroutine's executor and resumes the awaiter when it finishes.
+template <typename T = void>
+class [[nodiscard]] Task {
+public:
+	using promise_type = TaskPromise<T>;
+
+	explicit Task(std::coroutine_handle<promise_type> coroutine) : handle(coroutine) {}
+	Task(Task&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+	Task(const Task&) = delete;
+	Task& operator=(const Task&) = delete;
+
+	~Task() {
+		if (handle) {
+			handle.destroy();
+		}
+	}
+
+	// Starts the child and suspends the caller until the child finishes
+	struct Awaiter {
+		std::coroutine_handle<promise_type> child;
+
+		bool await_ready() const noexcept {
+			return false;
+		}
+
+		template <typename Promise>
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> caller) noexcept {
+			child.promise().executor = executor_of(caller);
+			child.promise().continuation = caller;
+			return child;
+		}
+
+		T await_resume() {
+			return child.promise().result();
+		}
+	};
+
+	Awaiter operator co_await() && noexcept {
+		return Awaiter{handle};
+	}
+
+private:
+	std::coroutine_handle<promise_type> handle;
+};
+
+inline Task<void> TaskPromise<void>::get_return_object() {
+	return Task<void>(std::coroutine_handle<TaskPromise>::from_promise(*this));
+}
+
+// Suspend and continue on a worker of executor
+inline auto schedule_on(WorkStealingExecutor& executor) {
+	struct Awaiter {
+		WorkStealingExecutor& executor;
+
+		bool await_ready() const noexcept {
+			return false;
+		}
+
+		void await_suspend(std::coroutine_handle<> handle) {
+			executor.spawn([handle]() { handle.resume(); });
+		}
+
+		void await_resume() const noexcept {}
+	};
+	return Awaiter{executor};
+}
+
+// co_await on a Future registers a continuation instead of parking a thread
+template <typename T>
+struct FutureAwaiter {
+	Future<T> future;
+	WorkStealingExecutor* executor = nullptr;
+	std::coroutine_handle<> handle;
+
+	explicit FutureAwaiter(Future<T>&& source) : future(std::move(source)) {}
+
+	bool await_ready() const {
+		return future.is_ready();
+	}
+
+	template <typename Promise>
+	void await_suspend(std::coroutine_handle<Promise> caller) {
+		handle = caller;
+		executor = executor_of(caller);
+		future.on_ready([](void* self) {
+			auto* awaiter = static_cast<FutureAwaiter*>(self);
+			resume_on(awaiter->executor, awaiter->handle);
+		}, this);
+	}
+
+	T await_resume() {
+		return future.get();
+	}
+};
+
+template <typename T>
+FutureAwaiter<T> operator co_await(Future<T>&& future) {
+	return FutureAwaiter<T>(std::move(future));
+}
+
+// Unbounded queue whose pop() suspends the coroutine until a value or close()
+template <typename T>
+class AsyncQueue {
+	// A suspended consumer and where its value goes
+	struct Waiter {
+		std::coroutine_handle<> handle;
+		WorkStealingExecutor* executor;
+		std::optional<T>* slot;
+	};
+
+public:
+	// Add a value, handing it straight to a suspended consumer if there is
+	// one. Returns false once the queue is closed.
+	bool push(T value) {
+		std::unique_lock<std::mutex> lock(mutex);
+		if (closed) {
+			return false;
+		}
+		if (waiters.empty()) {
+			items.push_back(std::move(value));
+			return true;
+		}
+		Waiter waiter = waiters.front();
+		waiters.pop_front();
+		lock.unlock();
+		waiter.slot->emplace(std::move(value));
+		resume_on(waiter.executor, waiter.handle);
+		return true;
+	}
+
+	// Stop accepting values; suspended consumers wake up with nothing
+	void close() {
+		std::deque<Waiter> woken;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			closed = true;
+			woken.swap(waiters);
+		}
+		for (const Waiter& waiter : woken) {
+			resume_on(waiter.executor, waiter.handle);
+		}
+	}
+
+	// Takes a value if one is queued, otherwise parks the coroutine as a waiter
+	struct PopAwaiter {
+		AsyncQueue& queue;
+		std::optional<T> slot;
+
+		bool await_ready() const noexcept {
+			return false;
+		}
+
+		// Returning false resumes right away without suspending
+		template <typename Promise>
+		bool await_suspend(std::coroutine_handle<Promise> handle) {
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			if (!queue.items.empty()) {
+				slot.emplace(std::move(queue.items.front()));
+				queue.items.pop_front();
+				return false;
+			}
+			if (queue.closed) {
+				return false;
+			}
+			queue.waiters.push_back(Waiter{handle, executor_of(handle), &slot});
+			return true;
+		}
+
+		std::optional<T> await_resume() {
+			return std::move(slot);
+		}
+	};
+
+	// co_await pop() yields the next value, or nullopt once closed and drained
+	PopAwaiter pop() {
+		return PopAwaiter{*this, std::nullopt};
+	}
+
+private:
+	std::mutex mutex;
+	std::deque<T> items;
+	std::deque<Waiter> waiters;
+	bool closed = false;
+};
+
+// Mutex whose lock() suspends the coroutine instead of blocking the thread.
+// unlock() hands ownership directly to the oldest waiter.
+class AsyncMutex {
+	struct Waiter {
+		std::coroutine_handle<> handle;
+		WorkStealingExecutor* executor;
+	};
+
+public:
+	// Unlocks on destruction, like std::lock_guard
+	class ScopedLock {
+	public:
+		explicit ScopedLock(AsyncMutex& owner) : mutex(&owner) {}
+		ScopedLock(ScopedLock&& other) noexcept : mutex(std::exchange(other.mutex, nullptr)) {}
+		ScopedLock(const ScopedLock&) = delete;
+		ScopedLock& operator=(const ScopedLock&) = delete;
+
+		~ScopedLock() {
+			if (mutex) {
+				mutex->unlock();
+			}
+		}
+
+	private:
+		AsyncMutex* mutex;
+	};
+
+	// Takes the mutex if it is free, otherwise queues the coroutine
+	struct LockAwaiter {
+		AsyncMutex& mutex;
+
+		bool await_ready() const noexcept {
+			return false;
+		}
+
+		template <typename Promise>
+		bool await_suspend(std::coroutine_handle<Promise> handle) {
+			std::lock_guard<std::mutex> lock(mutex.guard);
+			if (!mutex.locked) {
+				mutex.locked = true;
+				return false;
+			}
+			mutex.waiters.push_back(Waiter{handle, executor_of(handle)});
+			return true;
+		}
+
+		ScopedLock await_resume() {
+			return ScopedLock(mutex);
+		}
+	};
+
+	// co_await lock() yields a ScopedLock
+	LockAwaiter lock() {
+		return LockAwaiter{*this};
+	}
+
+	void unlock() {
+		Waiter next;
+		{
+			std::lock_guard<std::mutex> lock(guard);
+			if (waiters.empty()) {
+				locked = false;
+				return;
+			}
+			// Stay locked: ownership passes to the waiter
+			next = waiters.front();
+			waiters.pop_front();
+		}
+		resume_on(next.executor, next.handle);
+	}
+
+private:
+	// Protects locked and waiters; held only for a few instructions
+	std::mutex guard;
+	bool locked = false;
+	std::deque<Waiter> waiters;
+};
+
+// One-shot value that any number of coroutines can co_await; the coroutine
+// counterpart of shared_future. set() resumes every suspended reader.
+template <typename T>
+class AsyncEvent {
+	struct Waiter {
+		std::coroutine_handle<> handle;
+		WorkStealingExecutor* executor;
+	};
+
+public:
+	// Publish the value and resume every waiting coroutine; call once
+	void set(T new_value) {
+		std::vector<Waiter> woken;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (value) {
+				throw std::logic_error("AsyncEvent is already set");
+			}
+			value.emplace(std::move(new_value));
+			woken.swap(waiters);
+		}
+		for (const Waiter& waiter : woken) {
+			resume_on(waiter.executor, waiter.handle);
+		}
+	}
+
+	// Continues at once if the value is set, otherwise parks the coroutine
+	struct WaitAwaiter {
+		AsyncEvent& event;
+
+		bool await_ready() const noexcept {
+			return false;
+		}
+
+		template <typename Promise>
+		bool await_suspend(std::coroutine_handle<Promise> handle) {
+			std::lock_guard<std::mutex> lock(event.mutex);
+			if (event.value) {
+				return false;
+			}
+			event.waiters.push_back(Waiter{handle, executor_of(handle)});
+			return true;
+		}
+
+		// The value never changes once set, so readers share it by reference
+		const T& await_resume() const {
+			return *event.value;
+		}
+	};
+
+	// co_await wait() yields the value once it is set
+	WaitAwaiter wait() {
+		return WaitAwaiter{*this};
+	}
+
+private:
+	std::mutex mutex;
+	std::optional<T> value;
+	std::vector<Waiter> waiters;
+};
+
+// One thread that resumes sleeping coroutines when their deadline passes
+class TimerQueue {
+	struct Timer {
+		std::chrono::steady_clock::time_point deadline;
+		std::coroutine_handle<> handle;
+		WorkStealingExecutor* executor;
+
+		bool operator>(const Timer& other) const {
+			return deadline > other.deadline;
+		}
+	};
+
+public:
+	TimerQueue() : thread([this]() { run(); }) {}
+	TimerQueue(const TimerQueue&) = delete;
+	TimerQueue& operator=(const TimerQueue&) = delete;
+
+	// Destructor that fires every pending timer early, so no coroutine is stranded
+	~TimerQueue() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_one();
+		thread.join();
+	}
+
+	// Registers the coroutine with a deadline
+	struct SleepAwaiter {
+		TimerQueue& timers;
+		std::chrono::steady_clock::duration duration;
+
+		bool await_ready() const noexcept {
+			return duration <= std::chrono::steady_clock::duration::zero();
+		}
+
+		template <typename Promise>
+		void await_suspend(std::coroutine_handle<Promise> handle) {
+			timers.add(Timer{std::chrono::steady_clock::now() + duration, handle, executor_of(handle)});
+		}
+
+		void await_resume() const noexcept {}
+	};
+
+	// co_await sleep_for(duration) suspends for at least duration
+	SleepAwaiter sleep_for(std::chrono::steady_clock::duration duration) {
+		return SleepAwaiter{*this, duration};
+	}
+
+private:
+	void add(Timer timer) {
+		bool earliest;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			earliest = timers.empty() || timer.deadline < timers.top().deadline;
+			timers.push(timer);
+		}
+		// The timer thread only needs to recompute its sleep for a new earliest deadline
+		if (earliest) {
+			wake.notify_one();
+		}
+	}
+
+	// Sleep until the earliest deadline, then resume everything that is due
+	void run() {
+		std::unique_lock<std::mutex> lock(mutex);
+		for (;;) {
+			if (timers.empty()) {
+				if (stopping) {
+					return;
+				}
+				SmallBlockAllocator::release_local();
+				wake.wait(lock);
+				continue;
+			}
+			// Copy the deadline: an add() while waiting may reallocate the heap
+			const std::chrono::steady_clock::time_point deadline = timers.top().deadline;
+			if (!stopping && deadline > std::chrono::steady_clock::now()) {
+				wake.wait_until(lock, deadline);
+				continue;
+			}
+			const Timer due = timers.top();
+			timers.pop();
+			lock.unlock();
+			resume_on(due.executor, due.handle);
+			lock.lock();
+		}
+	}
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers;
+	bool stopping = false;
+	std::thread thread;
+};
+
+// Fire-and-forget coroutine that drives a Task from run_on
+struct DetachedTask {
+	struct promise_type {
+		WorkStealingExecutor* executor;
+
+		// Takes the executor from the coroutine's first parameter
+		template <typename... Args>
+		explicit promise_type(WorkStealingExecutor& runner, Args&&...) : executor(&runner) {}
+
+		DetachedTask get_return_object() const noexcept {
+			return {};
+		}
+
+		std::suspend_never initial_suspend() const noexcept {
+			return {};
+		}
+
+		std::suspend_never final_suspend() const noexcept {
+			return {};
+		}
+
+		void return_void() const noexcept {}
+
+		void unhandled_exception() const noexcept {
+			std::terminate();
+		}
+
+		static void* operator new(std::size_t size) {
+			return SmallBlockAllocator::allocate(size);
+		}
+
+		static void operator delete(void* frame, std::size_t size) {
+			SmallBlockAllocator::deallocate(frame, size);
+		}
+	};
+};
+
+// The result is held here until the task's frame, with its by-value
+// parameters, has been destroyed. Only then is it published, so get()
+// returning means the task is completely finished.
+template <typename T>
+DetachedTask drive_task(WorkStealingExecutor& executor, Task<T> task, FutureNode<T>* node) {
+	co_await schedule_on(executor);
+	std::optional<std::conditional_t<std::is_void_v<T>, bool, T>> value;
+	std::exception_ptr failure;
+	{
+		Task<T> running = std::move(task);
+		try {
+			if constexpr (std::is_void_v<T>) {
+				co_await std::move(running);
+				value.emplace(true);
+			} else {
+				value.emplace(co_await std::move(running));
+			}
+		} catch (...) {
+			failure = std::current_exception();
+		}
+	}
+	if (failure) {
+		node->result.set_exception(failure);
+	} else if constexpr (std::is_void_v<T>) {
+		node->result.set_value();
+	} else {
+		node->result.set_value(std::move(*value));
+	}
+	node->result.release();
+}
+
+// Start task on executor and return a Future for its result
+template <typename T>
+Future<T> run_on(WorkStealingExecutor& executor, Task<T> task) {
+	auto* node = new FutureNode<T>();
+	Future<T> result = node->get_future();
+	drive_task(executor, std::move(task), node);
+	return result;
+}
+
+// The producer from thread_synchronization_demo.cpp: suspends on a timer
+// instead of sleeping a thread between items
+Task<int> producer_task(AsyncQueue<int>& queue, TimerQueue& timers) {
+	int produced = 0;
+	for (int count = 10; count > 0; --count) {
+		queue.push(count);
+		++produced;
+		co_await timers.sleep_for(std::chrono::milliseconds(100));
+	}
+	queue.close();
+	co_return produced;
+}
+
+// The consumer: suspends on the queue instead of a condition variable
+Task<int> consumer_task(AsyncQueue<int>& queue) {
+	int received = 0;
+	while (std::optional<int> data = co_await queue.pop()) {
+		std::cout << "Consumer received data: " << *data << std::endl;
+		++received;
+	}
+	co_return received;
+}
+
+// Keeps the promise for 100 ms without holding a thread, then sets it
+Task<int> fulfil_later(Promise<int> promise, TimerQueue& timers) {
+	co_await timers.sleep_for(std::chrono::milliseconds(100));
+	promise.set_value(6);
+	co_return 0;
+}
+
+Task<int> await_promise(Future<int> future) {
+	const int value = co_await std::move(future);
+	std::cout << "Promise result: " << value << std::endl;
+	co_return value;
+}
+
+// The shared_future readers: each suspends on the same one-shot value
+Task<int> read_shared(AsyncEvent<int>& shared, int reader) {
+	const int value = co_await shared.wait();
+	const std::string line = "Shared future result in task " + std::to_string(reader) + ": " + std::to_string(value);
+	std::cout << line << std::endl;
+	co_return value;
+}
+
+// Sets the shared value after 100 ms without holding a thread
+Task<void> set_shared_later(AsyncEvent<int>& shared, TimerQueue& timers) {
+	co_await timers.sleep_for(std::chrono::milliseconds(100));
+	shared.set(7);
+}
+
+int main() {
+	WorkStealingExecutor executor;
+	// Declared after the executor so it is destroyed first
+	TimerQueue timers;
+
+	AsyncQueue<int> queue;
+	Future<int> consumed = run_on(executor, consumer_task(queue));
+	Future<int> produced = run_on(executor, producer_task(queue, timers));
+	const int producedCount = produced.get();
+	const int consumedCount = consumed.get();
+	std::cout << "Produced " << producedCount << ", consumed " << consumedCount << std::endl;
+
+	FutureState<int> state;
+	Promise<int> promise(state);
+	Future<int> awaited = run_on(executor, await_promise(promise.get_future()));
+	Future<int> setter = run_on(executor, fulfil_later(std::move(promise), timers));
+	awaited.get();
+	setter.get();
+
+	// shared_future example: two readers suspend on one value instead of
+	// blocking two threads in get()
+	AsyncEvent<int> shared;
+	Future<int> reader1 = run_on(executor, read_shared(shared, 1));
+	Future<int> reader2 = run_on(executor, read_shared(shared, 2));
+	run_on(executor, set_shared_later(shared, timers)).get();
+	reader1.get();
+	reader2.get();
+	return 0;
+}
+
+// One logical task: sleep, then update a shared counter under the async mutex
+Task<int> sleep_and_count(TimerQueue& timers, AsyncMutex& mutex, long long& counter, int id) {
+	co_await timers.sleep_for(std::chrono::milliseconds(1 + id % 50));
+	auto lock = co_await mutex.lock();
+	++counter;
+	co_return 1;
+}
+
+int main() {
+	// Tens of thousands of concurrent tasks on a handful of threads. The
+	// workers are held while a wave is queued, so every wave peaks with all
+	// of its frames and start jobs live at once: the first wave fills the
+	// block pool and later waves must reuse its frames and jobs.
+	const int tasks = 50000;
+	WorkStealingExecutor executor;
+	TimerQueue timers;
+	AsyncMutex mutex;
+	long long counter = 0;
+	// Blocks may still sit in the free lists of threads that are not allocating
+	const std::size_t slack = tasks / 100;
+	bool reused = true;
+
+	for (int wave = 1; wave <= 3; ++wave) {
+		std::atomic<std::size_t> held{0};
+		std::atomic<bool> released{false};
+		for (std::size_t i = 0; i < executor.size(); ++i) {
+			executor.spawn([&held, &released]() {
+				held.fetch_add(1);
+				held.notify_all();
+				released.wait(false);
+			});
+		}
+		for (std::size_t seen = held.load(); seen < executor.size(); seen = held.load()) {
+			held.wait(seen);
+		}
+
+		const std::size_t heapBefore = SmallBlockAllocator::heap_allocations.load();
+		const auto start = std::chrono::steady_clock::now();
+		std::vector<Future<int>> results;
+		results.reserve(tasks);
+		for (int id = 0; id < tasks; ++id) {
+			results.push_back(run_on(executor, sleep_and_count(timers, mutex, counter, id)));
+		}
+		released.store(true);
+		released.notify_all();
+		int finished = 0;
+		for (auto& result : results) {
+			finished += result.get();
+		}
+		const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		const std::size_t fromHeap = SmallBlockAllocator::heap_allocations.load() - heapBefore;
+		std::cout << "Wave " << wave << ": " << finished << " tasks on " << executor.size() << " workers in " << elapsed.count()
+			<< " ms, " << fromHeap << " blocks from the heap" << std::endl;
+		reused = reused && (wave == 1 || fromHeap <= slack);
+	}
+	std::cout << "Counter: " << counter << std::endl;
+	std::cout << (reused ? "Later waves reused the pooled blocks" : "Later waves FAILED to reuse the pooled blocks") << std::endl;
+	return reused ? 0 : 1;
+}
+
+/*
+ * One-shot broadcast event: one atomic word instead of shared_future fan-out
+ */
+
+// Set once, read by any number of threads. Waiters park on a single status
+// word and set() wakes all of them with one wake-all. Readers after set()
+// pay one acquire load and get a reference; nothing is copied or counted.
+template <typename T>
+class BroadcastEvent {
+	// Values of status
+	static constexpr std::uint32_t empty = 0;
+	// At least one reader is parked and needs the wake-up
+	static constexpr std::uint32_t waiting = 1;
+	static constexpr std::uint32_t ready = 2;
+
+public:
+	BroadcastEvent() = default;
+	BroadcastEvent(const BroadcastEvent&) = delete;
+	BroadcastEvent& operator=(const BroadcastEvent&) = delete;
+
+	~BroadcastEvent() {
+		if (status.load(std::memory_order_relaxed) == ready) {
+			value().~T();
+		}
+	}
+
+	// Publish the value; call at most once
+	template <typename... Args>
+	void set(Args&&... args) {
+		new (storage) T(std::forward<Args>(args)...);
+		// Skip the syscall entirely when nobody parked
+		if (status.exchange(ready, std::memory_order_acq_rel) == waiting) {
+			status.notify_all();
+		}
+	}
+
+	bool is_set() const {
+		return status.load(std::memory_order_acquire) == ready;
+	}
+
+	// Block until set. Parked readers all share the one word.
+	void wait() const {
+		std::uint32_t seen = status.load(std::memory_order_acquire);
+		while (seen != ready) {
+			if (seen == empty && !status.compare_exchange_weak(seen, waiting, std::memory_order_acquire)) {
+				continue;
+			}
+			status.wait(waiting, std::memory_order_acquire);
+			seen = status.load(std::memory_order_acquire);
+		}
+	}
+
+	// Wait, then read the value in place
+	const T& get() const {
+		wait();
+		return value();
+	}
+
+private:
+	const T& value() const {
+		return *std::launder(reinterpret_cast<const T*>(storage));
+	}
+
+	T& value() {
+		return *std::launder(reinterpret_cast<T*>(storage));
+	}
+
+	mutable std::atomic<std::uint32_t> status{empty};
+	alignas(T) unsigned char storage[sizeof(T)];
+};
+
+int main() {
+	// The shared_future example from thread_synchronization_demo.cpp; threads
+	// take a reference to the event instead of copying a refcounted future
+	BroadcastEvent<int> sharedEvent;
+	std::thread sharedThread1([&sharedEvent]() {
+		const int result = sharedEvent.get();
+		std::cout << "Shared event result in thread 1: " << result << std::endl;
+	});
+	std::thread sharedThread2([&sharedEvent]() {
+		const int result = sharedEvent.get();
+		std::cout << "Shared event result in thread 2: " << result << std::endl;
+	});
+	sharedEvent.set(7);
+	sharedThread1.join();
+	sharedThread2.join();
+	return 0;
+}
+
+// Park waiters on a fresh one-shot value, set it, and measure until the last
+// waiter has read it. make() returns {setter, reader} callables for one round.
+// Returns {wake-all latency in microseconds, late-reader ns per read}.
+template <typename Make>
+std::pair<double, double> benchmark_broadcast(unsigned waiters, Make make) {
+	const int rounds = 5;
+	const int lateReads = 200000;
+	double wakeMicros = 0;
+	double lateNanos = 0;
+	for (int round = 0; round < rounds; ++round) {
+		auto [setter, reader] = make();
+		std::atomic<unsigned> arrived{0};
+		std::atomic<std::int64_t> lastWake{0};
+		// Time spent in late reads, summed over threads; also keeps the reads alive
+		std::atomic<std::int64_t> lateTicks{0};
+		std::atomic<long long> checksum{0};
+		std::vector<std::thread> threads;
+		for (unsigned i = 0; i < waiters; ++i) {
+			threads.emplace_back([&, reader]() {
+				arrived.fetch_add(1, std::memory_order_relaxed);
+				long long sum = reader();
+				const auto woken = std::chrono::steady_clock::now();
+				std::int64_t seen = lastWake.load(std::memory_order_relaxed);
+				while (seen < woken.time_since_epoch().count()
+					&& !lastWake.compare_exchange_weak(seen, woken.time_since_epoch().count(), std::memory_order_relaxed)) {
+				}
+				// Fast path once the value is published
+				for (int read = 0; read < lateReads; ++read) {
+					sum += reader();
+				}
+				lateTicks.fetch_add((std::chrono::steady_clock::now() - woken).count(), std::memory_order_relaxed);
+				checksum.fetch_add(sum, std::memory_order_relaxed);
+			});
+		}
+		// Give every waiter time to park before publishing
+		while (arrived.load(std::memory_order_relaxed) < waiters) {
+			std::this_thread::yield();
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		const auto setAt = std::chrono::steady_clock::now();
+		setter();
+		for (auto& thread : threads) {
+			thread.join();
+		}
+		if (checksum.load() != 7LL * (lateReads + 1) * waiters) {
+			std::cout << "Wrong checksum" << std::endl;
+		}
+		const std::chrono::steady_clock::time_point lastWoken{std::chrono::steady_clock::duration(lastWake.load())};
+		wakeMicros += std::chrono::duration<double, std::micro>(lastWoken - setAt).count();
+		const std::chrono::steady_clock::duration late(lateTicks.load());
+		lateNanos += std::chrono::duration<double, std::nano>(late).count() / (static_cast<double>(waiters) * lateReads);
+	}
+	return {wakeMicros / rounds, lateNanos / rounds};
+}
+
+int main() {
+	std::cout << "waiters | BroadcastEvent wake-all us, late read ns | shared_future wake-all us, late read ns" << std::endl;
+	for (unsigned waiters = 1; waiters <= 256; waiters *= 4) {
+		const auto event = benchmark_broadcast(waiters, []() {
+			auto shared = std::make_shared<BroadcastEvent<int>>();
+			return std::pair{[shared]() { shared->set(7); }, [shared]() { return static_cast<long long>(shared->get()); }};
+		});
+		// Each reader holds its own copy of the shared_future, as in the demo
+		const auto future = benchmark_broadcast(waiters, []() {
+			auto promise = std::make_shared<std::promise<int>>();
+			std::shared_future<int> shared = promise->get_future().share();
+			return std::pair{[promise]() { promise->set_value(7); }, [shared]() { return static_cast<long long>(shared.get()); }};
+		});
+		std::cout << waiters << " | " << event.first << ", " << event.second << " | " << future.first << ", " << future.second << std::endl;
+	}
+	return 0;
+}
+
+/*
+ * Arbitrary-precision parallel factorial
+ */
+
+// Unsigned big integer: base 2^32 limbs, least significant first, no
+// leading zero limbs (zero is the empty vector)
+struct BigInt {
+	std::vector<std::uint32_t> limbs;
+
+	BigInt() = default;
+
+	explicit BigInt(std::uint64_t value) {
+		for (; value; value >>= 32) {
+			limbs.push_back(static_cast<std::uint32_t>(value));
+		}
+	}
+
+	bool operator==(const BigInt&) const = default;
+
+	std::size_t bit_length() const {
+		return limbs.empty() ? 0 : 32 * limbs.size() - std::countl_zero(limbs.back());
+	}
+
+	// Decimal representation by repeated division; quadratic, meant for small values
+	std::string to_string() const {
+		if (limbs.empty()) {
+			return "0";
+		}
+		std::vector<std::uint32_t> value = limbs;
+		std::vector<std::uint32_t> chunks;
+		while (!value.empty()) {
+			std::uint64_t remainder = 0;
+			for (std::size_t i = value.size(); i-- > 0;) {
+				const std::uint64_t current = remainder << 32 | value[i];
+				value[i] = static_cast<std::uint32_t>(current / 1000000000);
+				remainder = current % 1000000000;
+			}
+			while (!value.empty() && value.back() == 0) {
+				value.pop_back();
+			}
+			chunks.push_back(static_cast<std::uint32_t>(remainder));
+		}
+		std::string text = std::to_string(chunks.back());
+		for (std::size_t i = chunks.size() - 1; i-- > 0;) {
+			const std::string chunk = std::to_string(chunks[i]);
+			text += std::string(9 - chunk.size(), '0') + chunk;
+		}
+		return text;
+	}
+};
+
+using LimbSpan = std::span<const std::uint32_t>;
+
+// Drop leading zero limbs
+void trim(std::vector<std::uint32_t>& limbs) {
+	while (!limbs.empty() && limbs.back() == 0) {
+		limbs.pop_back();
+	}
+}
+
+LimbSpan trimmed(LimbSpan limbs) {
+	while (!limbs.empty() && limbs.back() == 0) {
+		limbs = limbs.first(limbs.size() - 1);
+	}
+	return limbs;
+}
+
+// Run first and second, as two tasks when an executor is given
+template <typename First, typename Second>
+void fork_join(WorkStealingExecutor* executor, First&& first, Second&& second) {
+	if (!executor) {
+		first();
+		second();
+		return;
+	}
+	TaskGroup group(*executor);
+	group.run(std::forward<First>(first));
+	second();
+	group.wait();
+}
+
+// Call body(begin, end) over [0, count) in chunks of grain, as tasks when an executor is given
+template <typename Body>
+void parallel_for(WorkStealingExecutor* executor, std::size_t count, std::size_t grain, Body body) {
+	if (!executor || count <= grain) {
+		body(std::size_t{0}, count);
+		return;
+	}
+	TaskGroup group(*executor);
+	for (std::size_t begin = grain; begin < count; begin += grain) {
+		group.run([&body, begin, end = std::min(begin + grain, count)]() { body(begin, end); });
+	}
+	body(std::size_t{0}, grain);
+	group.wait();
+}
+
+// out += addend << (32 * shift)
+void add_shifted(std::vector<std::uint32_t>& out, LimbSpan addend, std::size_t shift) {
+	if (out.size() < addend.size() + shift) {
+		out.resize(addend.size() + shift);
+	}
+	std::uint64_t carry = 0;
+	std::size_t i = shift;
+	for (std::uint32_t limb : addend) {
+		const std::uint64_t sum = static_cast<std::uint64_t>(out[i]) + limb + carry;
+		out[i++] = static_cast<std::uint32_t>(sum);
+		carry = sum >> 32;
+	}
+	for (; carry; ++i) {
+		if (i == out.size()) {
+			out.push_back(0);
+		}
+		const std::uint64_t sum = static_cast<std::uint64_t>(out[i]) + carry;
+		out[i] = static_cast<std::uint32_t>(sum);
+		carry = sum >> 32;
+	}
+}
+
+// out -= subtrahend; out must not be smaller
+void subtract_in_place(std::vector<std::uint32_t>& out, LimbSpan subtrahend) {
+	std::int64_t borrow = 0;
+	for (std::size_t i = 0; i < out.size() && (i < subtrahend.size() || borrow); ++i) {
+		const std::int64_t difference = static_cast<std::int64_t>(out[i]) - (i < subtrahend.size() ? subtrahend[i] : 0) - borrow;
+		borrow = difference < 0;
+		out[i] = static_cast<std::uint32_t>(difference + (borrow << 32));
+	}
+	trim(out);
+}
+
+// O(n*m) product, fastest for short operands
+std::vector<std::uint32_t> multiply_schoolbook(LimbSpan a, LimbSpan b) {
+	std::vector<std::uint32_t> out(a.size() + b.size());
+	for (std::size_t i = 0; i < a.size(); ++i) {
+		std::uint64_t carry = 0;
+		for (std::size_t j = 0; j < b.size(); ++j) {
+			const std::uint64_t product = static_cast<std::uint64_t>(a[i]) * b[j] + out[i + j] + carry;
+			out[i + j] = static_cast<std::uint32_t>(product);
+			carry = product >> 32;
+		}
+		out[i + b.size()] = static_cast<std::uint32_t>(carry);
+	}
+	trim(out);
+	return out;
+}
+
+std::vector<std::uint32_t> multiply_limbs(LimbSpan a, LimbSpan b, WorkStealingExecutor* executor);
+
+// Shorter-operand size, in limbs, from which Karatsuba's three half-size
+// products become tasks; below it they are too cheap to pay for a spawn
+constexpr std::size_t karatsuba_task_threshold = 256;
+
+// Karatsuba: three half-size products instead of four. a is the longer operand.
+std::vector<std::uint32_t> multiply_karatsuba(LimbSpan a, LimbSpan b, WorkStealingExecutor* executor) {
+	const std::size_t half = (a.size() + 1) / 2;
+	if (b.size() <= half) {
+		// Unbalanced: multiply b by each b-sized slice of a
+		std::vector<std::uint32_t> out;
+		for (std::size_t offset = 0; offset < a.size(); offset += b.size()) {
+			add_shifted(out, multiply_limbs(a.subspan(offset, std::min(b.size(), a.size() - offset)), b, executor), offset);
+		}
+		trim(out);
+		return out;
+	}
+	const LimbSpan a0 = a.first(half);
+	const LimbSpan a1 = a.subspan(half);
+	const LimbSpan b0 = b.first(half);
+	const LimbSpan b1 = b.subspan(half);
+	std::vector<std::uint32_t> aSum(a0.begin(), a0.end());
+	add_shifted(aSum, a1, 0);
+	std::vector<std::uint32_t> bSum(b0.begin(), b0.end());
+	add_shifted(bSum, b1, 0);
+
+	std::vector<std::uint32_t> low;
+	std::vector<std::uint32_t> high;
+	std::vector<std::uint32_t> middle;
+	WorkStealingExecutor* forkOn = b.size() >= karatsuba_task_threshold ? executor : nullptr;
+	fork_join(forkOn, [&]() { low = multiply_limbs(a0, b0, executor); }, [&]() {
+		fork_join(forkOn, [&]() { high = multiply_limbs(a1, b1, executor); }, [&]() { middle = multiply_limbs(aSum, bSum, executor); });
+	});
+	subtract_in_place(middle, low);
+	subtract_in_place(middle, high);
+
+	std::vector<std::uint32_t> out = std::move(low);
+	add_shifted(out, middle, half);
+	add_shifted(out, high, 2 * half);
+	trim(out);
+	return out;
+}
+
+#if defined(__SIZEOF_INT128__)
+// Arithmetic modulo p = 2^64 - 2^32 + 1. p - 1 is divisible by 2^32, so
+// there are roots of unity for every power-of-two transform length we need,
+// and 2^64 = 2^32 - 1 (mod p) makes reduction a few adds instead of a divide.
+struct NttPrime {
+	static constexpr std::uint64_t modulus = 0xffffffff00000001ull;
+	// 2^32 - 1, what a carry out of bit 64 is worth
+	static constexpr std::uint64_t epsilon = 0xffffffffull;
+	// Generator of the multiplicative group
+	static constexpr std::uint64_t generator = 7;
+
+	static std::uint64_t add(std::uint64_t a, std::uint64_t b) {
+		std::uint64_t sum = a + b;
+		// Also correct on wrap-around: subtracting p then equals adding epsilon
+		if (sum < a || sum >= modulus) {
+			sum -= modulus;
+		}
+		return sum;
+	}
+
+	static std::uint64_t subtract(std::uint64_t a, std::uint64_t b) {
+		return a >= b ? a - b : a + (modulus - b);
+	}
+
+	// Full 64 x 64 -> 128-bit product; __extension__ marks the non-standard type
+	__extension__ typedef unsigned __int128 Wide;
+
+	static std::uint64_t multiply(std::uint64_t a, std::uint64_t b) {
+		const Wide product = static_cast<Wide>(a) * b;
+		const std::uint64_t low = static_cast<std::uint64_t>(product);
+		const std::uint64_t high = static_cast<std::uint64_t>(product >> 64);
+		// low + high_low * 2^64 + high_high * 2^96, with 2^64 = epsilon and 2^96 = -1
+		const std::uint64_t highHigh = high >> 32;
+		const std::uint64_t highLow = high & epsilon;
+		std::uint64_t t0 = low - highHigh;
+		if (low < highHigh) {
+			t0 -= epsilon;
+		}
+		const std::uint64_t t1 = highLow * epsilon;
+		std::uint64_t result = t0 + t1;
+		if (result < t1) {
+			result += epsilon;
+		}
+		return result >= modulus ? result - modulus : result;
+	}
+
+	static std::uint64_t power(std::uint64_t base, std::uint64_t exponent) {
+		std::uint64_t result = 1;
+		for (; exponent; exponent >>= 1) {
+			if (exponent & 1) {
+				result = multiply(result, base);
+			}
+			base = multiply(base, base);
+		}
+		return result;
+	}
+};
+
+// Reverse the low `bits` bits of value
+inline std::uint64_t reverse_bits(std::uint64_t value, int bits) {
+	std::uint64_t reversed = 0;
+	for (int i = 0; i < bits; ++i, value >>= 1) {
+		reversed = reversed << 1 | (value & 1);
+	}
+	return reversed;
+}
+
+// In-place iterative radix-2 number-theoretic transform. Each stage's
+// butterflies are independent, so a stage is split into parallel chunks.
+void number_theoretic_transform(std::vector<std::uint64_t>& values, bool inverse, WorkStealingExecutor* executor) {
+	const std::size_t size = values.size();
+	const int logSize = std::countr_zero(size);
+	const std::size_t grain = 1 << 15;
+	for (std::size_t i = 1; i < size; ++i) {
+		const std::size_t j = static_cast<std::size_t>(reverse_bits(i, logSize));
+		if (i < j) {
+			std::swap(values[i], values[j]);
+		}
+	}
+	std::uint64_t root = NttPrime::power(NttPrime::generator, (NttPrime::modulus - 1) >> logSize);
+	if (inverse) {
+		root = NttPrime::power(root, NttPrime::modulus - 2);
+	}
+	// twiddles[j] = root^j; a stage of length len uses every (size / len)-th entry
+	std::vector<std::uint64_t> twiddles(size / 2);
+	parallel_for(executor, twiddles.size(), grain, [&twiddles, root](std::size_t begin, std::size_t end) {
+		std::uint64_t twiddle = NttPrime::power(root, begin);
+		for (std::size_t j = begin; j < end; ++j) {
+			twiddles[j] = twiddle;
+			twiddle = NttPrime::multiply(twiddle, root);
+		}
+	});
+	for (int logHalf = 0; logHalf < logSize; ++logHalf) {
+		const std::size_t half = std::size_t{1} << logHalf;
+		const int logStride = logSize - logHalf - 1;
+		parallel_for(executor, size / 2, grain, [&values, &twiddles, half, logHalf, logStride](std::size_t begin, std::size_t end) {
+			for (std::size_t t = begin; t < end; ++t) {
+				const std::size_t j = t & (half - 1);
+				const std::size_t i = ((t >> logHalf) << (logHalf + 1)) + j;
+				const std::uint64_t u = values[i];
+				const std::uint64_t v = NttPrime::multiply(values[i + half], twiddles[j << logStride]);
+				values[i] = NttPrime::add(u, v);
+				values[i + half] = NttPrime::subtract(u, v);
+			}
+		});
+	}
+	if (inverse) {
+		const std::uint64_t scale = NttPrime::power(size, NttPrime::modulus - 2);
+		parallel_for(executor, size, grain, [&values, scale](std::size_t begin, std::size_t end) {
+			for (std::size_t i = begin; i < end; ++i) {
+				values[i] = NttPrime::multiply(values[i], scale);
+			}
+		});
+	}
+}
+
+// Split limbs into 16-bit digits, zero-padded to size
+std::vector<std::uint64_t> to_ntt_digits(LimbSpan limbs, std::size_t size) {
+	std::vector<std::uint64_t> digits(size);
+	for (std::size_t i = 0; i < limbs.size(); ++i) {
+		digits[2 * i] = limbs[i] & 0xffff;
+		digits[2 * i + 1] = limbs[i] >> 16;
+	}
+	return digits;
+}
+
+// Convolution of 16-bit digits through the NTT. Every coefficient is below
+// (digit count) * 2^32, far under p, so the modular result is exact.
+std::vector<std::uint32_t> multiply_ntt(LimbSpan a, LimbSpan b, WorkStealingExecutor* executor) {
+	const std::size_t size = std::bit_ceil(2 * (a.size() + b.size()));
+	const bool squaring = a.data() == b.data() && a.size() == b.size();
+	std::vector<std::uint64_t> product = to_ntt_digits(a, size);
+	if (squaring) {
+		number_theoretic_transform(product, false, executor);
+		for (std::uint64_t& value : product) {
+			value = NttPrime::multiply(value, value);
+		}
+	} else {
+		std::vector<std::uint64_t> other = to_ntt_digits(b, size);
+		fork_join(executor, [&]() { number_theoretic_transform(product, false, executor); },
+			[&]() { number_theoretic_transform(other, false, executor); });
+		for (std::size_t i = 0; i < size; ++i) {
+			product[i] = NttPrime::multiply(product[i], other[i]);
+		}
+	}
+	number_theoretic_transform(product, true, executor);
+
+	// Carry the coefficients back into 16-bit digits and pack pairs into limbs
+	std::vector<std::uint32_t> out(a.size() + b.size() + 1);
+	std::uint64_t carry = 0;
+	for (std::size_t i = 0; i < 2 * out.size(); ++i) {
+		const std::uint64_t value = (i < size ? product[i] : 0) + carry;
+		out[i / 2] |= static_cast<std::uint32_t>(value & 0xffff) << (16 * (i % 2));
+		carry = value >> 16;
+	}
+	trim(out);
+	return out;
+}
+#endif
+
+// Operand sizes, in limbs, where the next algorithm starts to win
+constexpr std::size_t karatsuba_threshold = 40;
+constexpr std::size_t ntt_threshold = 1500;
+
+// Pick schoolbook, Karatsuba or NTT by the size of the shorter operand
+std::vector<std::uint32_t> multiply_limbs(LimbSpan a, LimbSpan b, WorkStealingExecutor* executor) {
+	a = trimmed(a);
+	b = trimmed(b);
+	if (a.size() < b.size()) {
+		std::swap(a, b);
+	}
+	if (b.empty()) {
+		return {};
+	}
+	if (b.size() < karatsuba_threshold) {
+		return multiply_schoolbook(a, b);
+	}
+#if defined(__SIZEOF_INT128__)
+	if (b.size() >= ntt_threshold) {
+		return multiply_ntt(a, b, executor);
+	}
+#endif
+	return multiply_karatsuba(a, b, executor);
+}
+
+BigInt multiply(const BigInt& a, const BigInt& b, WorkStealingExecutor* executor = nullptr) {
+	BigInt result;
+	result.limbs = multiply_limbs(a.limbs, b.limbs, executor);
+	return result;
+}
+
+// value *= factor for a single-limb factor
+void multiply_small(BigInt& value, std::uint32_t factor) {
+	std::uint64_t carry = 0;
+	for (std::uint32_t& limb : value.limbs) {
+		const std::uint64_t product = static_cast<std::uint64_t>(limb) * factor + carry;
+		limb = static_cast<std::uint32_t>(product);
+		carry = product >> 32;
+	}
+	if (carry) {
+		value.limbs.push_back(static_cast<std::uint32_t>(carry));
+	}
+	trim(value.limbs);
+}
+
+// value <<= bits
+void shift_left(BigInt& value, std::uint64_t bits) {
+	if (value.limbs.empty() || bits == 0) {
+		return;
+	}
+	const std::size_t limbShift = bits / 32;
+	const unsigned bitShift = bits % 32;
+	std::vector<std::uint32_t> shifted(value.limbs.size() + limbShift + 1);
+	for (std::size_t i = 0; i < value.limbs.size(); ++i) {
+		const std::uint64_t wide = static_cast<std::uint64_t>(value.limbs[i]) << bitShift;
+		shifted[i + limbShift] |= static_cast<std::uint32_t>(wide);
+		shifted[i + limbShift + 1] = static_cast<std::uint32_t>(wide >> 32);
+	}
+	trim(shifted);
+	value.limbs = std::move(shifted);
+}
+
+// Binary-splitting product tree: balanced halves keep the big multiplications
+// balanced, and large subtrees become tasks
+BigInt product_tree(std::span<const std::uint32_t> factors, WorkStealingExecutor* executor) {
+	if (factors.size() <= 32) {
+		BigInt result(1);
+		for (std::uint32_t factor : factors) {
+			multiply_small(result, factor);
+		}
+		return result;
+	}
+	const std::size_t half = factors.size() / 2;
+	BigInt left;
+	BigInt right;
+	fork_join(factors.size() >= 1024 ? executor : nullptr, [&]() { left = product_tree(factors.first(half), executor); },
+		[&]() { right = product_tree(factors.subspan(half), executor); });
+	return multiply(left, right, executor);
+}
+
+// Primes up to n by the sieve of Eratosthenes
+std::vector<std::uint32_t> primes_up_to(std::uint32_t n) {
+	std::vector<bool> composite(static_cast<std::size_t>(n) + 1);
+	std::vector<std::uint32_t> primes;
+	for (std::uint64_t i = 2; i <= n; ++i) {
+		if (composite[i]) {
+			continue;
+		}
+		primes.push_back(static_cast<std::uint32_t>(i));
+		for (std::uint64_t multiple = i * i; multiple <= n; multiple += i) {
+			composite[multiple] = true;
+		}
+	}
+	return primes;
+}
+
+// Exponent of prime p in n! (Legendre's formula)
+std::uint64_t legendre_exponent(std::uint32_t n, std::uint32_t p) {
+	std::uint64_t exponent = 0;
+	for (std::uint64_t power = p; power <= n; power *= p) {
+		exponent += n / power;
+	}
+	return exponent;
+}
+
+// Product of p^e over (p, e) pairs by binary powering: square the running
+// result once per exponent bit and multiply in the primes whose exponent has
+// that bit. Most primes have exponent 1, so the big work is a few product
+// trees (built in parallel) and a short chain of squarings. Powers of two
+// are applied as a shift at the end.
+BigInt prime_power_product(const std::vector<std::pair<std::uint32_t, std::uint64_t>>& factors, WorkStealingExecutor* executor) {
+	std::uint64_t twos = 0;
+	std::uint64_t largest = 0;
+	for (const auto& [prime, exponent] : factors) {
+		if (prime == 2) {
+			twos = exponent;
+		} else {
+			largest = std::max(largest, exponent);
+		}
+	}
+	const int bits = std::bit_width(largest);
+	std::vector<std::vector<std::uint32_t>> primesWithBit(bits);
+	for (const auto& [prime, exponent] : factors) {
+		for (int bit = 0; prime != 2 && bit < bits; ++bit) {
+			if (exponent >> bit & 1) {
+				primesWithBit[bit].push_back(prime);
+			}
+		}
+	}
+	std::vector<BigInt> partial(bits);
+	if (executor) {
+		TaskGroup group(*executor);
+		for (int bit = 0; bit < bits; ++bit) {
+			group.run([&partial, &primesWithBit, bit, executor]() { partial[bit] = product_tree(primesWithBit[bit], executor); });
+		}
+		group.wait();
+	} else {
+		for (int bit = 0; bit < bits; ++bit) {
+			partial[bit] = product_tree(primesWithBit[bit], nullptr);
+		}
+	}
+	BigInt result(1);
+	for (int bit = bits - 1; bit >= 0; --bit) {
+		result = multiply(result, result, executor);
+		result = multiply(result, partial[bit], executor);
+	}
+	shift_left(result, twos);
+	return result;
+}
+
+// n!, in parallel on executor when one is given
+BigInt big_factorial(std::uint32_t n, WorkStealingExecutor* executor = nullptr) {
+	std::vector<std::pair<std::uint32_t, std::uint64_t>> factors;
+	for (std::uint32_t prime : primes_up_to(n)) {
+		factors.emplace_back(prime, legendre_exponent(n, prime));
+	}
+	return prime_power_product(factors, executor);
+}
+
+// n choose k, from the same prime exponents: e(n) - e(k) - e(n - k)
+BigInt binomial(std::uint32_t n, std::uint32_t k, WorkStealingExecutor* executor = nullptr) {
+	if (k > n) {
+		return BigInt();
+	}
+	std::vector<std::pair<std::uint32_t, std::uint64_t>> factors;
+	for (std::uint32_t prime : primes_up_to(n)) {
+		const std::uint64_t exponent = legendre_exponent(n, prime) - legendre_exponent(k, prime) - legendre_exponent(n - k, prime);
+		if (exponent) {
+			factors.emplace_back(prime, exponent);
+		}
+	}
+	return prime_power_product(factors, executor);
+}
+
+// Factorial service entry points: the result comes back through a Future
+Future<BigInt> factorial_async(WorkStealingExecutor& executor, std::uint32_t n) {
+	return async_on(executor, [&executor, n]() { return big_factorial(n, &executor); });
+}
+
+Future<BigInt> binomial_async(WorkStealingExecutor& executor, std::uint32_t n, std::uint32_t k) {
+	return async_on(executor, [&executor, n, k]() { return binomial(n, k, &executor); });
+}
+
+// Multiply 1 * 2 * ... * n one factor at a time, as a reference
+BigInt factorial_naive(std::uint32_t n) {
+	BigInt result(1);
+	for (std::uint32_t i = 2; i <= n; ++i) {
+		multiply_small(result, i);
+	}
+	return result;
+}
+
+int main() {
+	WorkStealingExecutor executor;
+	// factorial(13) overflows int in thread_synchronization_demo.cpp; here it does not
+	std::cout << "25! = " << factorial_async(executor, 25).get().to_string() << std::endl;
+	std::cout << "C(100, 50) = " << binomial_async(executor, 100, 50).get().to_string() << std::endl;
+
+	// Every multiplication path must agree with schoolbook multiplication
+	std::mt19937 random(12345);
+	bool multiplyOk = true;
+	for (std::size_t limbs : {10u, 100u, 1000u, 3000u, 20000u}) {
+		BigInt a;
+		BigInt b;
+		for (std::size_t i = 0; i < limbs; ++i) {
+			a.limbs.push_back(static_cast<std::uint32_t>(random()) | 1);
+			b.limbs.push_back(static_cast<std::uint32_t>(random()) | 1);
+		}
+		b.limbs.resize(limbs * 2 / 3);
+		// a * a exercises the squaring shortcut
+		multiplyOk = multiplyOk && multiply(a, b, &executor).limbs == multiply_schoolbook(a.limbs, b.limbs)
+			&& multiply(a, a).limbs == multiply_schoolbook(a.limbs, a.limbs);
+	}
+	std::cout << "Multiplication paths " << (multiplyOk ? "agree" : "DISAGREE") << std::endl;
+
+	// The prime-factorization route must match the one-factor-at-a-time product
+	bool factorialOk = true;
+	for (std::uint32_t n : {0u, 1u, 2u, 13u, 100u, 1000u, 20000u}) {
+		factorialOk = factorialOk && factorial_async(executor, n).get() == factorial_naive(n);
+	}
+	std::cout << "Factorials " << (factorialOk ? "match" : "DO NOT MATCH") << " the naive product" << std::endl;
+	return 0;
+}
+
+// Seconds taken by f()
+template <typename F>
+double time_seconds(F f) {
+	const auto start = std::chrono::steady_clock::now();
+	f();
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main() {
+	// Against the naive loop, at a size where the loop still finishes
+	const std::uint32_t small = 100000;
+	BigInt naive;
+	BigInt engine;
+	const double naiveSeconds = time_seconds([&]() { naive = factorial_naive(small); });
+	const double engineSeconds = time_seconds([&]() { engine = big_factorial(small); });
+	std::cout << small << "!: naive loop " << naiveSeconds << " s, sequential engine " << engineSeconds << " s ("
+		<< naiveSeconds / engineSeconds << "x)" << (naive == engine ? "" : " MISMATCH") << std::endl;
+
+	// Against the sequential engine, across worker counts
+	const std::uint32_t n = 1000000;
+	BigInt sequential;
+	const double sequentialSeconds = time_seconds([&]() { sequential = big_factorial(n); });
+	const long long expectedBits = static_cast<long long>(std::lgamma(n + 1.0) / std::log(2.0)) + 1;
+	std::cout << n << "! has " << sequential.bit_length() << " bits (expected " << expectedBits << "), about "
+		<< static_cast<long long>(std::lgamma(n + 1.0) / std::log(10.0)) + 1 << " decimal digits" << std::endl;
+	std::cout << "Sequential: " << sequentialSeconds << " s" << std::endl;
+	const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+	for (unsigned threads = 1; threads <= std::max(cores, 4u); threads *= 2) {
+		WorkStealingExecutor executor(threads);
+		BigInt parallel;
+		const double seconds = time_seconds([&]() { parallel = factorial_async(executor, n).get(); });
+		std::cout << threads << " workers: " << seconds << " s, speedup " << sequentialSeconds / seconds << "x"
+			<< (parallel == sequential ? "" : " MISMATCH") << std::endl;
+	}
+	std::cout << "(hardware threads: " << cores << ")" << std::endl;
+	return 0;
+}